@@ -0,0 +1,310 @@
+#ifndef AI_SERVICE_HPP
+#define AI_SERVICE_HPP
+
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include "game.hpp"
+#include "search.hpp"
+#include "endgame.hpp"
+#include "eval.hpp"
+#include "pool.hpp"
+
+// 電腦下棋的排程：所有對局的要求排進同一個佇列，由固定數量的 worker 執行緒搜尋，
+// 不再每一步開一個執行緒。佇列先依優先順序（正式對局先於練習），再依期限排序（期限早的先算）。
+// 最近算過的局面存在快取中（只存殘局求解或搜尋夠深的結果）；同一個局面還在排隊時，
+// 新的要求直接等同一個結果，已經開始搜尋的則另外排一次。
+// submit 只在短暫的鎖內放入佇列，呼叫端（reactor 執行緒）不會等待搜尋
+#define AI_CACHE_SIZE 4096          // 快取與「正在搜尋」表的格數，2 的次方
+#define AI_MAX_WAITERS 8            // 一個搜尋最多讓幾個要求共用結果，超過就另外排一次
+#define AI_MIN_SEARCH_MS 20         // 排隊排到期限已過時，至少還搜尋這麼久
+#define AI_CACHE_MIN_DEPTH 8        // 一般搜尋至少完成這個深度才放進快取，時間很短的搜尋不存
+#define AI_QUEUE_RESERVE 1024
+
+enum AIPriority {
+    AI_PRIORITY_RATED = 0,      // 玩家原本要和真人對戰（等太久由電腦補位）
+    AI_PRIORITY_PRACTICE = 1    // 練習模式
+};
+
+struct AIResult {
+    int move;          // 位置 row * 8 + col，-1 表示沒有合法位置
+    int score;
+    bool solved;       // 殘局求解的結果（score 為終局子數差）
+    bool cached;       // 直接取自快取，沒有搜尋
+    double seconds;
+};
+
+// 接收電腦棋步的一方；ai_move_ready 在 worker 執行緒（命中快取時在 submit 的執行緒）呼叫，
+// 實作時只能把結果交回自己的執行緒，不要在這裡處理對局
+class AIClient {
+public:
+    virtual ~AIClient() {}
+    virtual void ai_move_ready(void* context, int tag, const AIResult& result) = 0;
+};
+
+class AIService {
+private:
+    struct Waiter {
+        AIClient* client;
+        void* context;
+        int tag;
+    };
+
+    struct Job {
+        Game position;
+        char piece;
+        int priority;
+        uint64_t key;
+        uint64_t sequence;   // 同優先、同期限時先到先算
+        bool started;        // 已經由 worker 取出；之後的要求不再合併進來
+        std::chrono::steady_clock::time_point deadline;
+        Waiter waiters[AI_MAX_WAITERS];
+        int waiter_count;
+    };
+
+    struct CacheEntry {
+        uint64_t black;
+        uint64_t white;
+        char piece;       // 0 表示空的格子
+        int move;
+        int score;
+        int depth;        // 一般搜尋完成的深度；殘局求解為剩下的空格數
+        bool solved;
+    };
+
+    // 排在最前面的是優先順序最高、期限最早的
+    struct JobOrder {
+        bool operator()(const Job* a, const Job* b) const {
+            if (a->priority != b->priority) return a->priority > b->priority;
+            if (a->deadline != b->deadline) return a->deadline > b->deadline;
+            return a->sequence > b->sequence;
+        }
+    };
+
+    TranspositionTable* tt;
+    const PatternEvaluator* evaluator;
+    int search_threads;
+    int endgame_empties;
+
+    std::mutex mutex;                    // 保護以下所有欄位
+    std::condition_variable work_ready;
+    std::vector<Job*> queue;             // heap，依 JobOrder 排序
+    ObjectPool<Job> job_pool;
+    std::vector<Job*> running;           // 每格存正在排隊或搜尋的 job（依 key），用來合併相同局面的要求
+    std::vector<CacheEntry> cache;
+    uint64_t next_sequence;
+    uint64_t searches;
+    uint64_t cache_hits;
+    uint64_t coalesced;
+    bool stopping;
+
+    std::vector<std::thread> workers;
+
+    static uint64_t position_key(const Game& position, char piece) {
+        Game game = position;
+        game.set_current_player(piece);
+        return game.get_hash();
+    }
+
+    static bool same_position(const Game& a, const Game& b) {
+        return a.get_black_board() == b.get_black_board() && a.get_white_board() == b.get_white_board();
+    }
+
+    void run() {
+        // 每個 worker 重複使用自己的殘局雜湊表；存的是分數上下界，換局面沿用也正確
+        EndgameSolver solver;
+        while (true) {
+            Job* job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                work_ready.wait(lock, [this]() { return stopping || !queue.empty(); });
+                if (stopping) return;
+                std::pop_heap(queue.begin(), queue.end(), JobOrder());
+                job = queue.back();
+                queue.pop_back();
+                job->started = true;
+            }
+
+            AIResult result;
+            result.cached = false;
+            result.solved = false;
+            result.seconds = 0;
+            int depth = 0;
+            // 期限是從 submit 開始算的；排隊等太久時仍至少搜尋 AI_MIN_SEARCH_MS，不會下出完全沒想過的棋
+            std::chrono::steady_clock::time_point deadline =
+                std::max(job->deadline, std::chrono::steady_clock::now() + std::chrono::milliseconds(AI_MIN_SEARCH_MS));
+            if (EndgameSolver::empties(job->position) <= endgame_empties) {
+                // 殘局直接算到終局，電腦下的是最佳解；期限內算不完就放棄，改用一般搜尋
+                EndgameResult solved = solver.solve(job->position, job->piece, deadline);
+                result.seconds = solved.seconds;
+                if (solved.complete) {
+                    result.move = solved.move;
+                    result.score = solved.score;
+                    result.solved = true;
+                    depth = EndgameSolver::empties(job->position);
+                }
+            }
+            if (!result.solved) {
+                long long remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    deadline - std::chrono::steady_clock::now()).count();
+                int time_ms = (int)std::max(remaining, (long long)AI_MIN_SEARCH_MS);
+                Searcher searcher(tt, search_threads);
+                searcher.set_evaluator(evaluator);
+                SearchResult searched = searcher.search(job->position, job->piece, SEARCH_MAX_DEPTH, time_ms);
+                result.move = searched.move;
+                result.score = searched.score;
+                result.seconds += searched.seconds;
+                depth = searched.depth;
+            }
+
+            Waiter waiters[AI_MAX_WAITERS];
+            int waiter_count;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                size_t slot = job->key & (AI_CACHE_SIZE - 1);
+                if (running[slot] == job) running[slot] = NULL;
+                // 時間很短的搜尋不存，之後時間充裕的要求才不會拿到淺的結果；
+                // 同一個局面已經有更深（或已求解）的結果時保留原本的
+                CacheEntry& entry = cache[slot];
+                bool same = entry.piece == job->piece && entry.black == job->position.get_black_board() &&
+                            entry.white == job->position.get_white_board();
+                bool better = !same || (!entry.solved && (result.solved || depth > entry.depth));
+                if (result.move >= 0 && (result.solved || depth >= AI_CACHE_MIN_DEPTH) && better) {
+                    entry.black = job->position.get_black_board();
+                    entry.white = job->position.get_white_board();
+                    entry.piece = job->piece;
+                    entry.move = result.move;
+                    entry.score = result.score;
+                    entry.depth = depth;
+                    entry.solved = result.solved;
+                }
+                waiter_count = job->waiter_count;
+                std::copy(job->waiters, job->waiters + waiter_count, waiters);
+                searches++;
+                job_pool.release(job);
+            }
+            for (int i = 0; i < waiter_count; i++) {
+                waiters[i].client->ai_move_ready(waiters[i].context, waiters[i].tag, result);
+            }
+        }
+    }
+
+public:
+    AIService(TranspositionTable* table, int worker_count, int threads_per_search, int solve_empties)
+        : tt(table), evaluator(NULL), search_threads(threads_per_search), endgame_empties(solve_empties),
+          running(AI_CACHE_SIZE, (Job*)NULL), cache(AI_CACHE_SIZE), next_sequence(0), searches(0),
+          cache_hits(0), coalesced(0), stopping(false) {
+        if (worker_count <= 0) worker_count = 1;
+        if (search_threads <= 0) search_threads = 1;
+        queue.reserve(AI_QUEUE_RESERVE);
+        for (size_t i = 0; i < cache.size(); i++) {
+            cache[i].piece = 0;
+            cache[i].depth = 0;
+        }
+        for (int i = 0; i < worker_count; i++) {
+            workers.push_back(std::thread(&AIService::run, this));
+        }
+    }
+
+    ~AIService() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        work_ready.notify_all();
+        for (size_t i = 0; i < workers.size(); i++) {
+            workers[i].join();
+        }
+    }
+
+    // 在第一次 submit 之前設定
+    void set_evaluator(const PatternEvaluator* pattern_evaluator) { evaluator = pattern_evaluator; }
+
+    // 要求電腦在 time_ms 毫秒內（從現在算起）替 piece 下一步；結果以 client->ai_move_ready(context, tag, ...) 交回。
+    // 快取中有這個局面時在這裡直接回呼
+    void submit(const Game& position, char piece, AIPriority priority, int time_ms,
+                AIClient* client, void* context, int tag) {
+        uint64_t key = position_key(position, piece);
+        size_t slot = key & (AI_CACHE_SIZE - 1);
+        Waiter waiter;
+        waiter.client = client;
+        waiter.context = context;
+        waiter.tag = tag;
+
+        AIResult result;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            const CacheEntry& entry = cache[slot];
+            if (entry.piece == piece && entry.black == position.get_black_board() &&
+                entry.white == position.get_white_board() && (entry.solved || entry.depth >= AI_CACHE_MIN_DEPTH)) {
+                cache_hits++;
+                result.move = entry.move;
+                result.score = entry.score;
+                result.solved = entry.solved;
+                result.cached = true;
+                result.seconds = 0;
+            } else {
+                // 同一個局面還在排隊：共用那次的結果。優先順序取兩者中較高的、期限取較早的，
+                // 讓先到的練習要求不會拖慢後到的正式對局；已經開始搜尋的不合併，
+                // 它的期限與搜尋深度已經定了
+                std::chrono::steady_clock::time_point deadline =
+                    std::chrono::steady_clock::now() + std::chrono::milliseconds(time_ms);
+                Job* same = running[slot];
+                bool identical = same != NULL && same->key == key && same->piece == piece &&
+                                 same_position(same->position, position);
+                if (identical && !same->started && same->waiter_count < AI_MAX_WAITERS) {
+                    same->waiters[same->waiter_count++] = waiter;
+                    coalesced++;
+                    if (priority < same->priority || deadline < same->deadline) {
+                        same->priority = std::min(same->priority, (int)priority);
+                        same->deadline = std::min(same->deadline, deadline);
+                        std::make_heap(queue.begin(), queue.end(), JobOrder());
+                    }
+                    return;
+                }
+
+                Job* job = job_pool.acquire();
+                job->position = position;
+                job->piece = piece;
+                job->priority = priority;
+                job->key = key;
+                job->sequence = next_sequence++;
+                job->started = false;
+                job->deadline = deadline;
+                job->waiters[0] = waiter;
+                job->waiter_count = 1;
+                if (same == NULL || (identical && same->started)) running[slot] = job;
+                queue.push_back(job);
+                std::push_heap(queue.begin(), queue.end(), JobOrder());
+                work_ready.notify_one();
+                return;
+            }
+        }
+        client->ai_move_ready(context, tag, result);
+    }
+
+    int size() const { return (int)workers.size(); }
+
+    size_t get_queued() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return queue.size();
+    }
+
+    // 實際搜尋的次數、命中快取的次數與合併到其他搜尋的次數
+    void get_counts(uint64_t& search_count, uint64_t& hit_count, uint64_t& coalesced_count) {
+        std::lock_guard<std::mutex> lock(mutex);
+        search_count = searches;
+        hit_count = cache_hits;
+        coalesced_count = coalesced;
+    }
+
+private:
+    AIService(const AIService&);
+    AIService& operator=(const AIService&);
+};
+
+#endif // AI_SERVICE_HPP
@@ -0,0 +1,45 @@
+#ifndef ALLOC_COUNTER_HPP
+#define ALLOC_COUNTER_HPP
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <stdint.h>
+
+// 計算整個程式的 heap 配置次數，用來確認下棋的路徑上沒有配置記憶體。
+// 這裡取代了全域的 operator new/delete，整個程式只能有一個 .cpp include 這個檔案。
+// new/delete 不能被 inline，否則 gcc 會把 malloc 與 delete、new 與 free 配對而誤報 -Wmismatched-new-delete
+static std::atomic<uint64_t> heap_allocations(0);
+
+__attribute__((noinline)) void* operator new(size_t size) {
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    void* p = malloc(size ? size : 1);
+    if (p == NULL) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete[](void* p) noexcept {
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete[](void* p, size_t) noexcept {
+    free(p);
+}
+
+static inline uint64_t allocation_count() {
+    return heap_allocations.load(std::memory_order_relaxed);
+}
+
+#endif // ALLOC_COUNTER_HPP
@@ -0,0 +1,387 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <thread>
+#include <chrono>
+#include <stdint.h>
+#include "game.hpp"
+#include "search.hpp"
+#include "transposition.hpp"
+#include "endgame.hpp"
+#include "eval.hpp"
+#include "symmetry.hpp"
+
+#define BENCH_SEED 20240601
+#define BENCH_DEFAULT_DEPTH 7
+#define BENCH_DEFAULT_POSITIONS 20
+#define BENCH_TT_MB 64
+#define BENCH_DEFAULT_EMPTIES 20
+#define BENCH_PLAYOUT_DEPTH 3      // 殘局測試局面：隨機開局後雙方以這個深度的搜尋下到指定空格數
+#define BENCH_VERIFY_EMPTIES 10    // 空格數不超過此值時，另外用完整的 minimax 驗證殘局求解的結果
+#define BENCH_EVAL_POSITIONS 10000
+#define BENCH_EVAL_ROUNDS 50       // 評估速度測試：每個局面重複評估的次數
+
+// 固定種子的隨機開局，讓每次測量用的是同一組局面
+// empties > 0 時隨機下 10 手後改由淺層搜尋接手，下到剩下指定的空格數（較接近實戰的殘局）；
+// 否則隨機下 8 到 27 手
+static std::vector<Game> make_positions(int count, unsigned int seed, int empties = 0) {
+    std::vector<Game> positions;
+    while ((int)positions.size() < count) {
+        Game game;
+        char player = 'X';
+        int plies = (empties > 0) ? 60 - empties : 8 + rand_r(&seed) % 20;
+        bool ok = true;
+
+        for (int i = 0; i < plies; i++) {
+            uint64_t moves = game.get_valid_moves(player);
+            if (moves == 0) {
+                player = (player == 'X') ? 'O' : 'X';
+                if (!game.has_valid_moves(player)) {
+                    ok = false;
+                    break;
+                }
+                game.set_current_player(player);
+                continue;
+            }
+            int sq;
+            if (empties > 0 && i >= 10) {
+                Searcher searcher;
+                sq = searcher.search(game, player, BENCH_PLAYOUT_DEPTH, 0).move;
+            } else {
+                int pick = rand_r(&seed) % __builtin_popcountll(moves);
+                for (int k = 0; k < pick; k++) moves &= moves - 1;
+                sq = __builtin_ctzll(moves);
+            }
+            game.make_move(sq / 8, sq % 8, player);
+            player = (player == 'X') ? 'O' : 'X';
+        }
+
+        if (ok && game.has_valid_moves(player)) {
+            game.set_current_player(player);
+            positions.push_back(game);
+        }
+    }
+    return positions;
+}
+
+struct BenchTotal {
+    uint64_t nodes;
+    double seconds;
+};
+
+// 同樣的局面與深度，比較不用置換表與使用置換表時的節點數與時間
+static int bench_search(int depth, int count) {
+    std::vector<Game> positions = make_positions(count, BENCH_SEED);
+    TranspositionTable tt(BENCH_TT_MB);
+
+    BenchTotal plain = {0, 0};
+    BenchTotal hashed = {0, 0};
+    int mismatches = 0;
+
+    std::cout << "depth " << depth << ", " << count << " positions, TT "
+              << tt.size_bytes() / (1024 * 1024) << " MB\n";
+    std::cout << std::setw(4) << "#" << std::setw(14) << "nodes(no TT)" << std::setw(14) << "nodes(TT)"
+              << std::setw(9) << "ratio" << "\n";
+
+    for (int i = 0; i < count; i++) {
+        const Game& game = positions[i];
+        char player = game.get_current_player();
+
+        Searcher without;
+        SearchResult a = without.search(game, player, depth, 0);
+
+        tt.clear();
+        Searcher with(&tt);
+        SearchResult b = with.search(game, player, depth, 0);
+
+        // 同一層內相同局面的剩餘深度相同，置換表不應改變結果
+        if (a.move != b.move || a.score != b.score) {
+            mismatches++;
+        }
+
+        plain.nodes += a.nodes;
+        plain.seconds += a.seconds;
+        hashed.nodes += b.nodes;
+        hashed.seconds += b.seconds;
+
+        std::cout << std::setw(4) << i << std::setw(14) << a.nodes << std::setw(14) << b.nodes
+                  << std::setw(8) << std::fixed << std::setprecision(2)
+                  << (b.nodes ? (double)a.nodes / b.nodes : 0.0) << "x\n";
+    }
+
+    std::cout << "no TT: " << plain.nodes << " nodes, " << std::setprecision(3) << plain.seconds << " s, "
+              << (uint64_t)(plain.seconds > 0 ? plain.nodes / plain.seconds : 0) << " nps\n";
+    std::cout << "TT:    " << hashed.nodes << " nodes, " << hashed.seconds << " s, "
+              << (uint64_t)(hashed.seconds > 0 ? hashed.nodes / hashed.seconds : 0) << " nps\n";
+    std::cout << "node reduction: " << std::setprecision(2)
+              << (hashed.nodes ? (double)plain.nodes / hashed.nodes : 0.0) << "x, "
+              << "result mismatches: " << mismatches << "\n";
+    return mismatches == 0 ? 0 : 1;
+}
+
+// 固定深度下比較不同執行緒數的速度；每個局面的結果都必須和單執行緒相同
+static int bench_smp(int depth, int count, int max_threads) {
+    std::vector<Game> positions = make_positions(count, BENCH_SEED);
+    TranspositionTable tt(BENCH_TT_MB);
+
+    std::vector<int> thread_counts;
+    for (int t = 1; t < max_threads; t *= 2) thread_counts.push_back(t);
+    thread_counts.push_back(max_threads);
+
+    std::vector<SearchResult> reference(count);
+    double base_seconds = 0;
+    int mismatches = 0;
+
+    std::cout << "depth " << depth << ", " << count << " positions, TT "
+              << tt.size_bytes() / (1024 * 1024) << " MB, "
+              << std::thread::hardware_concurrency() << " cores\n";
+    std::cout << std::setw(8) << "threads" << std::setw(14) << "nodes" << std::setw(10) << "seconds"
+              << std::setw(12) << "nps" << std::setw(10) << "speedup" << std::setw(12) << "mismatches" << "\n";
+
+    for (size_t k = 0; k < thread_counts.size(); k++) {
+        int threads = thread_counts[k];
+        BenchTotal total = {0, 0};
+        int wrong = 0;
+
+        for (int i = 0; i < count; i++) {
+            const Game& game = positions[i];
+            tt.clear();
+            Searcher searcher(&tt, threads);
+            SearchResult r = searcher.search(game, game.get_current_player(), depth, 0);
+
+            if (threads == 1) {
+                reference[i] = r;
+            } else if (r.move != reference[i].move || r.score != reference[i].score) {
+                wrong++;
+            }
+            total.nodes += r.nodes;
+            total.seconds += r.seconds;
+        }
+        if (threads == 1) base_seconds = total.seconds;
+        mismatches += wrong;
+
+        std::cout << std::setw(8) << threads << std::setw(14) << total.nodes
+                  << std::setw(10) << std::fixed << std::setprecision(3) << total.seconds
+                  << std::setw(12) << (uint64_t)(total.seconds > 0 ? total.nodes / total.seconds : 0)
+                  << std::setw(9) << std::setprecision(2)
+                  << (total.seconds > 0 ? base_seconds / total.seconds : 0.0) << "x"
+                  << std::setw(12) << wrong << "\n";
+    }
+    return mismatches == 0 ? 0 : 1;
+}
+
+// 直接用 Game 展開整棵樹，作為殘局求解的對照
+static int minimax(const Game& game, char player) {
+    char opponent = (player == 'X') ? 'O' : 'X';
+    uint64_t moves = game.get_valid_moves(player);
+    if (moves == 0) {
+        if (!game.has_valid_moves(opponent)) {
+            int diff = game.get_black_count() - game.get_white_count();
+            return (player == 'X') ? diff : -diff;
+        }
+        return -minimax(game, opponent);
+    }
+
+    int best = -65;
+    for (uint64_t b = moves; b; b &= b - 1) {
+        int sq = __builtin_ctzll(b);
+        Game child = game;
+        child.make_move(sq / 8, sq % 8, player);
+        int score = -minimax(child, opponent);
+        if (score > best) best = score;
+    }
+    return best;
+}
+
+// 殘局求解：每個局面的節點數與時間，空格少時同時驗證結果
+static int bench_endgame(int empties, int count) {
+    std::vector<Game> positions = make_positions(count, BENCH_SEED, empties);
+    bool verify = empties <= BENCH_VERIFY_EMPTIES;
+    BenchTotal total = {0, 0};
+    double worst = 0;
+    int mismatches = 0;
+
+    std::cout << empties << " empties, " << count << " positions"
+              << (verify ? ", verified by minimax" : "") << "\n";
+    std::cout << std::setw(4) << "#" << std::setw(6) << "move" << std::setw(7) << "score"
+              << std::setw(6) << "wld" << std::setw(14) << "nodes" << std::setw(10) << "seconds" << "\n";
+
+    for (int i = 0; i < count; i++) {
+        const Game& game = positions[i];
+        char player = game.get_current_player();
+
+        EndgameSolver solver;
+        EndgameResult r = solver.solve(game, player);
+        EndgameResult wld = solver.solve(game, player, true);
+
+        if (wld.score != (r.score > 0) - (r.score < 0)) {
+            mismatches++;
+        }
+        if (verify) {
+            // 分數與求解器給的那一步都要對
+            Game child = game;
+            char opponent = (player == 'X') ? 'O' : 'X';
+            if (minimax(game, player) != r.score ||
+                (r.move >= 0 && (!child.make_move(r.move / 8, r.move % 8, player) ||
+                                 -minimax(child, opponent) != r.score))) {
+                mismatches++;
+            }
+        }
+
+        total.nodes += r.nodes;
+        total.seconds += r.seconds;
+        if (r.seconds > worst) worst = r.seconds;
+
+        std::cout << std::setw(4) << i << std::setw(6)
+                  << (r.move >= 0 ? game.format_move(r.move / 8, r.move % 8) : "--")
+                  << std::setw(7) << r.score << std::setw(6) << wld.score << std::setw(14) << r.nodes
+                  << std::setw(10) << std::fixed << std::setprecision(3) << r.seconds << "\n";
+    }
+
+    std::cout << "total: " << total.nodes << " nodes, " << total.seconds << " s, "
+              << (uint64_t)(total.seconds > 0 ? total.nodes / total.seconds : 0) << " nps, "
+              << "average " << total.seconds / count << " s, worst " << worst << " s\n";
+    std::cout << "mismatches: " << mismatches << "\n";
+    return mismatches == 0 ? 0 : 1;
+}
+
+struct EvalTiming {
+    double features;   // 每秒算出幾個局面的全部特徵
+    double evals;      // 每秒評估次數
+    uint64_t checksum;
+};
+
+static EvalTiming time_eval(const PatternEvaluator& evaluator, const std::vector<uint64_t>& own,
+                            const std::vector<uint64_t>& opp) {
+    EvalTiming timing = {0, 0, 0};
+    uint32_t features[EVAL_FEATURE_COUNT];
+    size_t total = own.size() * BENCH_EVAL_ROUNDS;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int round = 0; round < BENCH_EVAL_ROUNDS; round++) {
+        for (size_t i = 0; i < own.size(); i++) {
+            evaluator.compute_features(own[i], opp[i], features);
+            timing.checksum += features[i % EVAL_FEATURE_COUNT];
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    timing.features = seconds > 0 ? total / seconds : 0;
+
+    start = std::chrono::steady_clock::now();
+    for (int round = 0; round < BENCH_EVAL_ROUNDS; round++) {
+        for (size_t i = 0; i < own.size(); i++) {
+            timing.checksum += evaluator.evaluate(own[i], opp[i]);
+        }
+    }
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    timing.evals = seconds > 0 ? total / seconds : 0;
+    return timing;
+}
+
+// 樣式評估：向量化與一般寫法算出的特徵必須相同、8 種對稱的局面評估值必須相同，並量測每秒評估次數
+static int bench_eval(int count, const std::string& weights_path) {
+    PatternEvaluator evaluator;
+    if (!weights_path.empty() && !evaluator.load(weights_path)) {
+        return 1;
+    }
+    bool has_simd = evaluator.is_vectorized();
+
+    std::vector<Game> positions = make_positions(count, BENCH_SEED);
+    std::vector<uint64_t> own(count), opp(count);
+    for (int i = 0; i < count; i++) {
+        bool black = positions[i].get_current_player() == 'X';
+        own[i] = black ? positions[i].get_black_board() : positions[i].get_white_board();
+        opp[i] = black ? positions[i].get_white_board() : positions[i].get_black_board();
+    }
+
+    int mismatches = 0;
+    uint32_t simd[EVAL_FEATURE_COUNT], scalar[EVAL_FEATURE_COUNT];
+    for (int i = 0; i < count; i++) {
+        if (has_simd) {
+            evaluator.set_vectorized(true);
+            evaluator.compute_features(own[i], opp[i], simd);
+            evaluator.set_vectorized(false);
+            evaluator.compute_features(own[i], opp[i], scalar);
+            if (memcmp(simd, scalar, sizeof(simd)) != 0) mismatches++;
+        }
+        int score = evaluator.evaluate(own[i], opp[i]);
+        for (int s = 1; s < SYMMETRY_COUNT; s++) {
+            if (evaluator.evaluate(transform_board(own[i], s), transform_board(opp[i], s)) != score) {
+                mismatches++;
+                break;
+            }
+        }
+    }
+
+    std::cout << count << " positions x " << BENCH_EVAL_ROUNDS << " rounds, " << EVAL_FEATURE_COUNT
+              << " features, " << (weights_path.empty() ? "default weights" : weights_path) << "\n";
+    std::cout << std::setw(8) << "" << std::setw(16) << "features/s" << std::setw(16) << "evals/s" << "\n";
+
+    evaluator.set_vectorized(false);
+    EvalTiming plain = time_eval(evaluator, own, opp);
+    std::cout << std::setw(8) << "scalar" << std::setw(16) << (uint64_t)plain.features
+              << std::setw(16) << (uint64_t)plain.evals << "\n";
+    if (has_simd) {
+        evaluator.set_vectorized(true);
+        EvalTiming fast = time_eval(evaluator, own, opp);
+        std::cout << std::setw(8) << "avx2" << std::setw(16) << (uint64_t)fast.features
+                  << std::setw(16) << (uint64_t)fast.evals << "  (" << std::fixed << std::setprecision(2)
+                  << (plain.evals > 0 ? fast.evals / plain.evals : 0.0) << "x)\n";
+        if (fast.checksum != plain.checksum) mismatches++;
+    } else {
+        std::cout << "avx2 not available\n";
+    }
+    std::cout << "mismatches: " << mismatches << "\n";
+    return mismatches == 0 ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cout << "Usage: " << argv[0] << " search [depth] [positions]\n"
+                  << "       " << argv[0] << " smp [depth] [positions] [max_threads]\n"
+                  << "       " << argv[0] << " endgame [empties] [positions]\n"
+                  << "       " << argv[0] << " eval [positions] [weights_file]\n"
+                  << "       " << argv[0] << " weights <output>\n";
+        return 1;
+    }
+
+    std::string mode = argv[1];
+    if (mode == "search") {
+        int depth = (argc > 2) ? atoi(argv[2]) : BENCH_DEFAULT_DEPTH;
+        int count = (argc > 3) ? atoi(argv[3]) : BENCH_DEFAULT_POSITIONS;
+        if (depth <= 0) depth = BENCH_DEFAULT_DEPTH;
+        if (count <= 0) count = BENCH_DEFAULT_POSITIONS;
+        return bench_search(depth, count);
+    }
+    if (mode == "smp") {
+        int depth = (argc > 2) ? atoi(argv[2]) : BENCH_DEFAULT_DEPTH;
+        int count = (argc > 3) ? atoi(argv[3]) : BENCH_DEFAULT_POSITIONS;
+        int max_threads = (argc > 4) ? atoi(argv[4]) : (int)std::thread::hardware_concurrency();
+        if (depth <= 0) depth = BENCH_DEFAULT_DEPTH;
+        if (count <= 0) count = BENCH_DEFAULT_POSITIONS;
+        if (max_threads <= 0) max_threads = 1;
+        return bench_smp(depth, count, max_threads);
+    }
+    if (mode == "endgame") {
+        int empties = (argc > 2) ? atoi(argv[2]) : BENCH_DEFAULT_EMPTIES;
+        int count = (argc > 3) ? atoi(argv[3]) : BENCH_DEFAULT_POSITIONS;
+        if (empties <= 0 || empties > ENDGAME_MAX_EMPTIES) empties = BENCH_DEFAULT_EMPTIES;
+        if (count <= 0) count = BENCH_DEFAULT_POSITIONS;
+        return bench_endgame(empties, count);
+    }
+    if (mode == "eval") {
+        int count = (argc > 2) ? atoi(argv[2]) : BENCH_EVAL_POSITIONS;
+        if (count <= 0) count = BENCH_EVAL_POSITIONS;
+        return bench_eval(count, (argc > 3) ? argv[3] : "");
+    }
+    // 寫出預設權重，作為訓練或手動調整的起點
+    if (mode == "weights" && argc > 2) {
+        PatternEvaluator evaluator;
+        return evaluator.save(argv[2]) ? 0 : 1;
+    }
+
+    std::cout << "Unknown mode: " << mode << "\n";
+    return 1;
+}
\ No newline at end of file
@@ -0,0 +1,137 @@
+#ifndef BOOK_HPP
+#define BOOK_HPP
+
+#include <stdint.h>
+#include <cstring>
+#include <string>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "game.hpp"
+#include "symmetry.hpp"
+
+// 開局庫：依局面 key 排序的固定長度陣列，整個檔案 mmap 進來直接二分搜尋，載入時不必解析。
+// 對稱的局面只存一份：key 由 8 種對稱中最小的代表局面算出，棋步也存成代表局面上的位置。
+//   檔頭 16 bytes：BookHeader；之後 count 筆 BookEntry，依 key 由小到大排列
+//   數值以本機的 byte order 存放（由 book_builder 在同一類機器上產生）
+#define BOOK_MAGIC "RVBK"
+#define BOOK_VERSION 1
+
+struct BookHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t count;
+};
+
+struct BookEntry {
+    uint64_t key;
+    int16_t score;     // 以行棋方的角度，同 Searcher 的分數
+    uint8_t move;      // 代表局面上的位置（row * 8 + col）
+    uint8_t depth;     // 搜尋深度
+    uint32_t games;    // 在對局紀錄中出現的次數（只由起始局面展開的為 0）
+};
+
+static_assert(sizeof(BookHeader) == 16, "BookHeader must be 16 bytes");
+static_assert(sizeof(BookEntry) == 16, "BookEntry must be 16 bytes");
+
+// 局面 key：代表局面的兩個 bitboard 與行棋方混合成 64 bits
+static inline uint64_t book_key(uint64_t canonical_black, uint64_t canonical_white, char player) {
+    uint64_t h = canonical_black * 0x9e3779b97f4a7c15ULL;
+    h ^= (h >> 29) ^ canonical_white;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= (h >> 32) ^ (player == 'X' ? 0 : 0x94d049bb133111ebULL);
+    h *= 0x9e3779b97f4a7c15ULL;
+    return h ^ (h >> 31);
+}
+
+// 查詢局面對應的 key 與所用的對稱
+static inline uint64_t book_position_key(const Game& game, char player, int& symmetry) {
+    uint64_t black, white;
+    symmetry = canonical_symmetry(game.get_black_board(), game.get_white_board(), black, white);
+    return book_key(black, white, player);
+}
+
+class OpeningBook {
+private:
+    void* mapping;
+    size_t mapping_size;
+    const BookEntry* entries;
+    size_t count;
+
+public:
+    OpeningBook() : mapping(NULL), mapping_size(0), entries(NULL), count(0) {}
+
+    ~OpeningBook() {
+        if (mapping != NULL) munmap(mapping, mapping_size);
+    }
+
+    bool open(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "Cannot open opening book " << path << ": " << strerror(errno) << "\n";
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(BookHeader)) {
+            std::cerr << path << ": not an opening book\n";
+            close(fd);
+            return false;
+        }
+        mapping_size = st.st_size;
+        mapping = mmap(NULL, mapping_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            std::cerr << "mmap failed: " << strerror(errno) << "\n";
+            mapping = NULL;
+            return false;
+        }
+
+        const BookHeader* header = (const BookHeader*)mapping;
+        if (memcmp(header->magic, BOOK_MAGIC, 4) != 0 || header->version != BOOK_VERSION ||
+            mapping_size != sizeof(BookHeader) + header->count * sizeof(BookEntry)) {
+            std::cerr << path << ": not an opening book (or unsupported version)\n";
+            return false;
+        }
+        entries = (const BookEntry*)((const char*)mapping + sizeof(BookHeader));
+        count = header->count;
+        return true;
+    }
+
+    size_t size() const { return count; }
+
+    // 找到時回傳 true，move 為實際局面上的位置（row * 8 + col），score 以 player 的角度
+    bool probe(const Game& game, char player, int& move, int& score) const {
+        if (count == 0) return false;
+
+        int symmetry;
+        uint64_t key = book_position_key(game, player, symmetry);
+        size_t lo = 0, hi = count;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (entries[mid].key < key) lo = mid + 1;
+            else hi = mid;
+        }
+        if (lo == count || entries[lo].key != key) return false;
+
+        // 把代表局面上的棋步轉回實際局面；同時確認它是合法位置，避免 key 碰撞
+        const BookEntry& entry = entries[lo];
+        for (uint64_t b = game.get_valid_moves(player); b; b &= b - 1) {
+            int sq = __builtin_ctzll(b);
+            if (transform_square(sq, symmetry) == entry.move) {
+                move = sq;
+                score = entry.score;
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    OpeningBook(const OpeningBook&);
+    OpeningBook& operator=(const OpeningBook&);
+};
+
+#endif // BOOK_HPP
@@ -0,0 +1,223 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <stdint.h>
+#include "game.hpp"
+#include "search.hpp"
+#include "transposition.hpp"
+#include "record.hpp"
+#include "book.hpp"
+
+#define BUILDER_DEFAULT_PLIES 4          // 由起始局面展開的步數
+#define BUILDER_DEFAULT_DEPTH 10         // 每個局面的搜尋深度
+#define BUILDER_DEFAULT_RECORD_PLIES 16  // 對局紀錄只取前幾步
+#define BUILDER_DEFAULT_MIN_GAMES 2      // 對局紀錄中至少出現幾次的局面才收錄
+#define BUILDER_TT_MB 256
+
+struct BookOptions {
+    std::string output;
+    std::vector<std::string> record_files;
+    int plies;
+    int depth;
+    int record_plies;
+    int min_games;
+    int threads;
+};
+
+// 待搜尋的局面；同一類對稱局面只留第一次遇到的那一個
+struct Candidate {
+    Game game;
+    char player;
+    uint32_t games;
+    bool from_start;
+};
+
+typedef std::map<uint64_t, Candidate> CandidateMap;
+
+static void add_candidate(CandidateMap& candidates, const Game& game, char player, bool from_start) {
+    int symmetry;
+    uint64_t key = book_position_key(game, player, symmetry);
+    CandidateMap::iterator it = candidates.find(key);
+    if (it == candidates.end()) {
+        Candidate c;
+        c.game = game;
+        c.player = player;
+        c.games = 0;
+        c.from_start = false;
+        it = candidates.insert(std::make_pair(key, c)).first;
+    }
+    if (from_start) it->second.from_start = true;
+    else it->second.games++;
+}
+
+// 由起始局面展開所有 plies 步以內的局面（pass 不算一步、也不收錄必須 pass 的局面）
+static void expand(CandidateMap& candidates, const Game& game, char player, int plies) {
+    if (plies == 0) return;
+    uint64_t moves = game.get_valid_moves(player);
+    char opponent = (player == 'X') ? 'O' : 'X';
+    if (moves == 0) {
+        if (game.has_valid_moves(opponent)) expand(candidates, game, opponent, plies);
+        return;
+    }
+
+    add_candidate(candidates, game, player, true);
+    for (uint64_t b = moves; b; b &= b - 1) {
+        int sq = __builtin_ctzll(b);
+        Game child = game;
+        child.make_move(sq / 8, sq % 8, player);
+        expand(candidates, child, opponent, plies - 1);
+    }
+}
+
+// 重播對局紀錄的前幾步，統計每個局面出現的次數
+static bool collect_records(CandidateMap& candidates, const std::string& path, int record_plies) {
+    RecordReader reader;
+    if (!reader.open(path)) return false;
+
+    RecordView r;
+    int games = 0;
+    while (reader.next(r)) {
+        Game game;
+        char player = 'X';
+        size_t plies = std::min(r.move_count, (size_t)record_plies);
+        for (size_t i = 0; i < plies; i++) {
+            if (!game.has_valid_moves(player)) {
+                player = (player == 'X') ? 'O' : 'X';
+            }
+            int sq = r.moves[i];
+            if (sq >= 64 || !game.get_valid_moves(player)) break;
+            add_candidate(candidates, game, player, false);
+            if (!game.make_move(sq / 8, sq % 8, player)) break;
+            player = (player == 'X') ? 'O' : 'X';
+        }
+        games++;
+    }
+    std::cout << path << ": " << games << " games\n";
+    return true;
+}
+
+static bool write_book(const std::string& path, const std::vector<BookEntry>& entries) {
+    FILE* f = fopen(path.c_str(), "wb");
+    if (f == NULL) {
+        std::cerr << "Cannot create " << path << "\n";
+        return false;
+    }
+    BookHeader header;
+    memcpy(header.magic, BOOK_MAGIC, 4);
+    header.version = BOOK_VERSION;
+    header.count = entries.size();
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+              (entries.empty() || fwrite(&entries[0], sizeof(BookEntry), entries.size(), f) == entries.size());
+    ok = (fclose(f) == 0) && ok;
+    if (!ok) std::cerr << "Write to " << path << " failed\n";
+    return ok;
+}
+
+static int build(const BookOptions& options) {
+    CandidateMap candidates;
+    expand(candidates, Game(), 'X', options.plies);
+    std::cout << candidates.size() << " positions within " << options.plies << " plies of the start\n";
+
+    for (size_t i = 0; i < options.record_files.size(); i++) {
+        if (!collect_records(candidates, options.record_files[i], options.record_plies)) return 1;
+    }
+
+    // 只在紀錄中出現太少次的局面不值得花時間深搜
+    for (CandidateMap::iterator it = candidates.begin(); it != candidates.end();) {
+        if (!it->second.from_start && (int)it->second.games < options.min_games) {
+            candidates.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+    std::cout << "searching " << candidates.size() << " positions to depth " << options.depth
+              << " with " << options.threads << " threads\n";
+
+    TranspositionTable tt(BUILDER_TT_MB);
+    std::vector<BookEntry> entries;
+    entries.reserve(candidates.size());
+    double seconds = 0;
+    size_t done = 0;
+
+    // std::map 依 key 排序，寫出的順序即為檔案需要的順序
+    for (CandidateMap::iterator it = candidates.begin(); it != candidates.end(); ++it) {
+        const Candidate& c = it->second;
+        Game game = c.game;
+        game.set_current_player(c.player);
+        Searcher searcher(&tt, options.threads);
+        SearchResult result = searcher.search(game, c.player, options.depth, 0);
+        seconds += result.seconds;
+        done++;
+        if (result.move < 0) continue;
+
+        int symmetry;
+        book_position_key(game, c.player, symmetry);
+        BookEntry entry;
+        entry.key = it->first;
+        entry.score = (int16_t)result.score;
+        entry.move = (uint8_t)transform_square(result.move, symmetry);
+        entry.depth = (uint8_t)result.depth;
+        entry.games = c.games;
+        entries.push_back(entry);
+
+        if (done % 100 == 0 || done == candidates.size()) {
+            std::cout << "  " << done << "/" << candidates.size() << " (" << std::fixed
+                      << std::setprecision(1) << seconds << " s)\n" << std::flush;
+        }
+    }
+
+    if (!write_book(options.output, entries)) return 1;
+    std::cout << "wrote " << entries.size() << " entries ("
+              << sizeof(BookHeader) + entries.size() * sizeof(BookEntry) << " bytes) to "
+              << options.output << "\n";
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cout << "Usage: " << argv[0] << " <output> [-p plies] [-d depth] [-t threads]"
+                  << " [-r record_file]... [-n record_plies] [-m min_games]\n";
+        return 1;
+    }
+
+    BookOptions options;
+    options.output = argv[1];
+    options.plies = BUILDER_DEFAULT_PLIES;
+    options.depth = BUILDER_DEFAULT_DEPTH;
+    options.record_plies = BUILDER_DEFAULT_RECORD_PLIES;
+    options.min_games = BUILDER_DEFAULT_MIN_GAMES;
+    options.threads = std::thread::hardware_concurrency();
+
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-p" && i + 1 < argc) {
+            options.plies = atoi(argv[++i]);
+        } else if (arg == "-d" && i + 1 < argc) {
+            options.depth = atoi(argv[++i]);
+        } else if (arg == "-t" && i + 1 < argc) {
+            options.threads = atoi(argv[++i]);
+        } else if (arg == "-r" && i + 1 < argc) {
+            options.record_files.push_back(argv[++i]);
+        } else if (arg == "-n" && i + 1 < argc) {
+            options.record_plies = atoi(argv[++i]);
+        } else if (arg == "-m" && i + 1 < argc) {
+            options.min_games = atoi(argv[++i]);
+        } else {
+            std::cout << "Unknown option: " << arg << "\n";
+            return 1;
+        }
+    }
+    if (options.plies < 0) options.plies = 0;
+    if (options.depth <= 0) options.depth = BUILDER_DEFAULT_DEPTH;
+    if (options.threads <= 0) options.threads = 1;
+    if (options.record_plies < 0) options.record_plies = 0;
+    if (options.min_games < 1) options.min_games = 1;
+
+    return build(options);
+}
\ No newline at end of file
@@ -0,0 +1,127 @@
+#ifndef BROADCAST_HPP
+#define BROADCAST_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/uio.h>
+#include "protocol.hpp"
+#include "pool.hpp"
+
+// 觀戰用的共用 frame：一則更新只編碼一次，所有觀眾的佇列都指向同一塊緩衝區，
+// 送出時以 writev 直接從這裡送，不複製到每條連線。
+// 參考計數不是 atomic：觀眾一律搬到對局所在的 shard，frame 只由那個 shard 的執行緒使用
+#define SHARED_FRAME_SIZE 512          // 一則更新可以包含幾個 frame（例如 MOVE_PLAYED + CHECKSUM）
+#define SPECTATOR_QUEUE_SIZE 64        // 每位觀眾最多排隊的更新數，2 的次方
+#define SPECTATOR_IOV_MAX 16           // 一次 sendmsg 最多送幾則
+
+struct SharedFrame {
+    uint8_t data[SHARED_FRAME_SIZE];
+    size_t length;
+    int refs;
+
+    // 空間不足時整個 frame 不寫入，回傳 false
+    bool append_frame(uint8_t opcode, const void* payload, size_t payload_length) {
+        if (length + FRAME_HEADER_SIZE + payload_length > SHARED_FRAME_SIZE) return false;
+        length += encode_frame(data + length, opcode, payload, payload_length);
+        return true;
+    }
+};
+
+typedef ObjectPool<SharedFrame> SharedFramePool;
+
+static inline SharedFrame* acquire_shared_frame(SharedFramePool& pool) {
+    SharedFrame* f = pool.acquire();
+    f->length = 0;
+    f->refs = 0;
+    return f;
+}
+
+// 沒有任何佇列再參考時放回池中
+static inline void release_shared_frame(SharedFramePool& pool, SharedFrame* f) {
+    if (--f->refs <= 0) pool.release(f);
+}
+
+// 一位觀眾待送出的共用 frame（環狀佇列）；第一則可能已送出一部分
+class FrameQueue {
+private:
+    SharedFrame* frames[SPECTATOR_QUEUE_SIZE];
+    size_t head;
+    size_t count;
+    size_t offset;   // 第一則已送出的 bytes
+    size_t bytes;    // 尚未送出的總 bytes
+
+public:
+    FrameQueue() : head(0), count(0), offset(0), bytes(0) {}
+
+    // 連線物件重複使用前必須先 clear
+    void reset() {
+        head = 0;
+        count = 0;
+        offset = 0;
+        bytes = 0;
+    }
+
+    // 佇列滿了回傳 false，不增加參考計數
+    bool push(SharedFrame* f) {
+        if (count == SPECTATOR_QUEUE_SIZE) return false;
+        frames[(head + count) & (SPECTATOR_QUEUE_SIZE - 1)] = f;
+        count++;
+        f->refs++;
+        bytes += f->length;
+        return true;
+    }
+
+    int fill_iovec(struct iovec* iov, int max) const {
+        int n = 0;
+        for (size_t i = 0; i < count && n < max; i++, n++) {
+            const SharedFrame* f = frames[(head + i) & (SPECTATOR_QUEUE_SIZE - 1)];
+            size_t skip = (i == 0) ? offset : 0;
+            iov[n].iov_base = (void*)(f->data + skip);
+            iov[n].iov_len = f->length - skip;
+        }
+        return n;
+    }
+
+    // 已送出 n bytes：送完的 frame 移出佇列並釋放參考
+    void consume(size_t n, SharedFramePool& pool) {
+        bytes -= n;
+        while (n > 0) {
+            SharedFrame* f = frames[head];
+            size_t rest = f->length - offset;
+            if (n < rest) {
+                offset += n;
+                return;
+            }
+            n -= rest;
+            offset = 0;
+            head = (head + 1) & (SPECTATOR_QUEUE_SIZE - 1);
+            count--;
+            release_shared_frame(pool, f);
+        }
+    }
+
+    // 丟掉還沒開始送的 frame；已送出一部分的第一則要送完，否則對方的 frame 邊界會錯亂
+    void drop_unsent(SharedFramePool& pool) {
+        size_t keep = (offset > 0) ? 1 : 0;
+        while (count > keep) {
+            SharedFrame* f = frames[(head + count - 1) & (SPECTATOR_QUEUE_SIZE - 1)];
+            count--;
+            bytes -= f->length;
+            release_shared_frame(pool, f);
+        }
+    }
+
+    void clear(SharedFramePool& pool) {
+        while (count > 0) {
+            release_shared_frame(pool, frames[head]);
+            head = (head + 1) & (SPECTATOR_QUEUE_SIZE - 1);
+            count--;
+        }
+        reset();
+    }
+
+    size_t size() const { return bytes; }
+    bool empty() const { return count == 0; }
+};
+
+#endif // BROADCAST_HPP
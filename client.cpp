@@ -2,15 +2,27 @@
 #include <string>
 #include <cstring>
 #include <cstdlib>
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+#include <errno.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
-#include <sstream>
-#include <vector>
 #include "game.hpp"
+#include "protocol.hpp"
 
-#define BUFFER_SIZE 1024
+// 畫面配置（行號從 1 起算）：第一次完整畫出，之後只以 ANSI 游標定位重畫有變動的格子與文字行
+#define SCREEN_HEADER_ROW 2
+#define SCREEN_COUNT_ROW 3
+#define SCREEN_STATUS_ROW 4
+#define SCREEN_BOARD_ROW 5      // 第 8 列，之後往下一列一行
+#define SCREEN_LABEL_ROW 13
+#define SCREEN_MESSAGE_ROW 15
+#define SCREEN_PROMPT_ROW 16
+#define SCREEN_TEXT_LINES 4     // 名字、子數、狀態、訊息四行
 
 class Client {
 private:
@@ -19,45 +31,331 @@ private:
     std::string player_name;
     std::string opponent_name;
     char my_piece;
+    FrameDecoder decoder;
+    bool resync_pending;
+    uint64_t hints;       // 本回合的合法位置（server 在 YOUR_TURN 送來）
+    bool my_turn;         // 輪到自己且還沒送出棋步
+    int pending_move;     // 已送出、server 還沒確認的棋步（row * 8 + col），-1 表示沒有
+    bool stdin_open;
+    std::string input;    // stdin 讀到、還沒湊成一行的部分
+    std::string message;  // 訊息行（錯誤、pass 通知等）
     
-    std::vector<std::string> split(const std::string& s, char delimiter) {
-        std::vector<std::string> tokens;
-        std::string token;
-        std::istringstream tokenStream(s);
-        while (std::getline(tokenStream, token, delimiter)) {
-            tokens.push_back(token);
+    // 畫面目前的內容，用來找出要重畫的部分
+    bool screen_drawn;
+    bool prompt_shown;
+    char shown[64];                             // 每一格畫出的字元（'X'、'O'、'+'、'*'），0 表示還沒畫
+    std::string shown_text[SCREEN_TEXT_LINES];
+    
+    void send_frame(uint8_t opcode, const void* payload, size_t length) {
+        uint8_t frame[MAX_FRAME_SIZE];
+        size_t n = encode_frame(frame, opcode, payload, length);
+        // server 可能已經關閉連線（例如先下出的棋步送出時對局剛結束），不要因 SIGPIPE 直接結束
+        send(sock, frame, n, MSG_NOSIGNAL);
+    }
+    
+    // 讀到湊滿一個完整 frame 為止；一次 read 多出來的 frame 留在 decoder 裡
+    // server 的心跳 PING 在這裡直接回覆，呼叫端不會看到
+    bool receive_frame(Frame& f) {
+        while (true) {
+            while (!decoder.next(f)) {
+                if (decoder.is_malformed()) {
+                    return false;
+                }
+                int valread = read(sock, decoder.write_ptr(), decoder.write_space());
+                if (valread <= 0) {
+                    return false;
+                }
+                decoder.commit(valread);
+            }
+            if (f.opcode != OP_PING) {
+                return true;
+            }
+            send_frame(OP_PONG, NULL, 0);
         }
-        return tokens;
     }
     
-    void send_message(const std::string& msg) {
-        send(sock, msg.c_str(), msg.length(), 0);
+    void set_board(const uint8_t* payload) {
+        game->set_bitboards(get_u64(payload), get_u64(payload + 8));
     }
     
-    std::string receive_message() {
-        char buffer[BUFFER_SIZE] = {0};
-        int valread = read(sock, buffer, BUFFER_SIZE);
-        if (valread <= 0) {
-            return "";
+    void request_resync() {
+        if (resync_pending) return;
+        resync_pending = true;
+        send_frame(OP_RESYNC, NULL, 0);
+    }
+    
+    // 處理棋盤同步用的 frame（MOVE_PLAYED、CHECKSUM、BOARD），其他 frame 回傳 false
+    bool apply_update(const Frame& f) {
+        if (f.opcode == OP_MOVE_PLAYED && f.length == MOVE_PLAYED_PAYLOAD_SIZE) {
+            int square = f.payload[0];
+            char piece = f.payload[1];
+            uint64_t flips = get_u64(f.payload + 2);
+            
+            // 在本地重播這一步，翻轉結果要和 server 一致
+            uint64_t before = (piece == 'X') ? game->get_white_board() : game->get_black_board();
+            bool ok = game->make_move(square / 8, square % 8, piece);
+            uint64_t after = (piece == 'X') ? game->get_white_board() : game->get_black_board();
+            if (!ok || (before & ~after) != flips) {
+                request_resync();
+            }
+            return true;
         }
-        return std::string(buffer);
+        if (f.opcode == OP_CHECKSUM && f.length == 4) {
+            uint32_t local = board_checksum(game->get_black_board(), game->get_white_board());
+            if (local != get_u32(f.payload)) {
+                request_resync();
+            }
+            return true;
+        }
+        if (f.opcode == OP_BOARD && f.length == BOARD_PAYLOAD_SIZE) {
+            set_board(f.payload);
+            resync_pending = false;
+            return true;
+        }
+        return false;
+    }
+    
+    // 只有輪到自己、棋盤已同步且沒有等待確認的棋步時才接受輸入
+    bool accepting_input() const {
+        return my_turn && pending_move < 0 && !resync_pending;
+    }
+    
+    void draw_text(std::ostringstream& out, int index, int row, const std::string& text) {
+        if (shown_text[index] == text) return;
+        out << "\033[" << row << ";1H\033[2K" << text;
+        shown_text[index] = text;
     }
     
-    void clear_screen() {
-        // 嘗試多種清屏方式
-        std::cout << "\033[2J";      // 清除整個螢幕
-        std::cout << "\033[H";       // 移動游標到左上角
-        std::cout << "\033[3J";      // 清除 scrollback buffer
-        std::cout << "\r";           // 回到行首
-        std::cout << std::flush;     // 強制刷新輸出
+    // 畫出 view：第一次清除螢幕並畫出固定的框架，之後只更新和上次不同的格子與文字行。
+    // 更新時先存下游標位置再還原，玩家正在輸入的文字不受影響
+    void render(const Game& view, const std::string& header, const std::string& status, uint64_t marks) {
+        std::ostringstream out;
+        bool full = !screen_drawn;
+        if (full) {
+            out << "\033[2J\033[3J";
+            for (int i = 0; i < 8; i++) {
+                out << "\033[" << (SCREEN_BOARD_ROW + i) << ";1H" << (8 - i);
+            }
+            out << "\033[" << SCREEN_LABEL_ROW << ";1H  a b c d e f g h";
+            memset(shown, 0, sizeof(shown));
+            for (int i = 0; i < SCREEN_TEXT_LINES; i++) {
+                shown_text[i] = "\n";   // 不會和任何一行相同，全部重畫
+            }
+            screen_drawn = true;
+        } else {
+            out << "\0337";
+        }
+        
+        std::ostringstream counts;
+        counts << "X: " << view.get_black_count() << "    O: " << view.get_white_count();
+        draw_text(out, 0, SCREEN_HEADER_ROW, header);
+        draw_text(out, 1, SCREEN_COUNT_ROW, counts.str());
+        draw_text(out, 2, SCREEN_STATUS_ROW, status);
+        draw_text(out, 3, SCREEN_MESSAGE_ROW, message);
         
-        // 如果上面都不行，用傳統方法
-        system("clear");
+        uint64_t black = view.get_black_board();
+        uint64_t white = view.get_white_board();
+        for (int sq = 0; sq < 64; sq++) {
+            uint64_t bit = 1ULL << sq;
+            char c = (black & bit) ? 'X' : (white & bit) ? 'O' : (marks & bit) ? '+' : '*';
+            if (c == shown[sq]) continue;
+            shown[sq] = c;
+            out << "\033[" << (SCREEN_BOARD_ROW + sq / 8) << ";" << (3 + 2 * (sq % 8)) << "H";
+            if (c == 'X') out << "\033[31mX\033[0m";
+            else if (c == 'O') out << "\033[32mO\033[0m";
+            else if (c == '+') out << "\033[33m+\033[0m";
+            else out << c;
+        }
+        
+        // 提示輸入的那一行出現或消失時重畫，游標停在那裡；否則回到原本的位置
+        bool want_prompt = accepting_input();
+        if (full || prompt_shown != want_prompt) {
+            out << "\033[" << SCREEN_PROMPT_ROW << ";1H\033[J";
+            if (want_prompt) out << "Enter your step. (ex. a1): ";
+            prompt_shown = want_prompt;
+        } else {
+            out << "\0338";
+        }
+        std::cout << out.str() << std::flush;
     }
     
-    void display_board(bool is_my_turn) {
-        clear_screen();
-        game->print_board(player_name, opponent_name, my_piece, is_my_turn);
+    // 畫面上顯示的是 server 確認過的棋盤，加上還在等確認的那一步
+    void render_game() {
+        Game view = *game;
+        if (pending_move >= 0) {
+            view.make_move(pending_move / 8, pending_move % 8, my_piece);
+        }
+        std::string header = player_name + "(you): " + my_piece + "    " +
+                             opponent_name + ": " + (my_piece == 'X' ? 'O' : 'X');
+        render(view, header, my_turn ? "now it's your turn." : "The opponent is thinking.",
+               accepting_input() ? hints : 0);
+    }
+    
+    // 在棋盤下方印出最後的訊息，之後程式結束
+    void finish(const std::string& text) {
+        if (screen_drawn) {
+            std::cout << "\033[" << SCREEN_MESSAGE_ROW << ";1H\033[J";
+        }
+        std::cout << text << std::flush;
+    }
+    
+    std::string result_text(const std::string& winner) const {
+        std::ostringstream out;
+        out << "===================\n";
+        out << "Game Over!\n";
+        out << winner << "\n";
+        out << "Black (X): " << game->get_black_count() << "\n";
+        out << "White (O): " << game->get_white_count() << "\n";
+        out << "===================\n";
+        return out.str();
+    }
+    
+    // 玩家輸入一行：合法的棋步先在本地下出並立刻畫出來，再送給 server，不等來回一趟
+    void handle_input(const std::string& line) {
+        prompt_shown = false;   // 終端機回顯的換行讓游標離開了提示行
+        int row, col;
+        if (!game->parse_move(line, row, col)) {
+            message = "Error: Invalid position format. Please try again.";
+        } else if (!(hints & (1ULL << (row * 8 + col))) || !game->is_valid_move(row, col, my_piece)) {
+            // 不合法的位置在本地就擋下，不必等 server 回應
+            message = "Error: Invalid move. Please try again.";
+        } else {
+            uint8_t square = row * 8 + col;
+            send_frame(OP_MOVE, &square, 1);
+            pending_move = square;
+            my_turn = false;
+            message.clear();
+        }
+        render_game();
+    }
+    
+    // stdin 只用 read 讀進 input（名字也是），不經過 cin 的緩衝區，事先輸入的內容不會遺失。
+    // 讀到結尾時，最後沒有換行的部分也算一行
+    void read_stdin() {
+        char buffer[256];
+        ssize_t n = read(STDIN_FILENO, buffer, sizeof(buffer));
+        if (n <= 0) {
+            stdin_open = false;
+            if (!input.empty() && input[input.size() - 1] != '\n') input += '\n';
+            return;
+        }
+        input.append(buffer, n);
+    }
+    
+    bool next_line(std::string& line) {
+        size_t end = input.find('\n');
+        if (end == std::string::npos) return false;
+        line = input.substr(0, end);
+        input.erase(0, end + 1);
+        if (!line.empty() && line[line.size() - 1] == '\r') {
+            line.resize(line.size() - 1);
+        }
+        return true;
+    }
+    
+    // 阻塞式讀一行；輸入已結束時回傳 false
+    bool read_line(std::string& line) {
+        while (!next_line(line)) {
+            if (!stdin_open) return false;
+            read_stdin();
+        }
+        return true;
+    }
+    
+    // 輪到自己時才處理排隊中的輸入；之前先輸入的棋步留到輪到自己再下，和以前用 getline 時一樣
+    void process_input() {
+        std::string line;
+        while (accepting_input() && next_line(line)) {
+            handle_input(line);
+        }
+    }
+    
+    // 處理 server 送來的一個 frame；對局結束或無法繼續時回傳 false
+    bool handle_frame(const Frame& f) {
+        if (f.opcode == OP_PING) {
+            send_frame(OP_PONG, NULL, 0);
+            return true;
+        }
+        if (f.opcode == OP_MOVE_PLAYED && f.length == MOVE_PLAYED_PAYLOAD_SIZE && f.payload[0] == pending_move) {
+            // 自己的棋步確認了，改由確認過的棋盤顯示；翻轉結果不同時 apply_update 會要求完整棋盤
+            pending_move = -1;
+        }
+        if (apply_update(f)) {
+            if (screen_drawn) render_game();
+            return true;
+        }
+        
+        if (f.opcode == OP_WAIT) {
+            std::cout << "Waiting for another player...\n";
+        }
+        else if (f.opcode == OP_RESUME_TOKEN && f.length == RESUME_TOKEN_SIZE) {
+            // server 重新啟動後，用這個 token 回到同一場對局
+            char token[2 * RESUME_TOKEN_SIZE + 1];
+            snprintf(token, sizeof(token), "%08x%016llx", get_u32(f.payload),
+                     (unsigned long long)get_u64(f.payload + 4));
+            message = std::string("Resume token: ") + token;
+        }
+        else if (f.opcode == OP_RESUME_FAILED) {
+            finish("Cannot resume: the match is over or the token is wrong\n");
+            return false;
+        }
+        else if (f.opcode == OP_START && f.length >= 1) {
+            // 續局時 server 接著送完整棋盤，名字沿用原本座位的
+            my_piece = f.payload[0];
+            opponent_name = std::string((const char*)f.payload + 1, f.length - 1);
+            *game = Game();
+            resync_pending = false;
+            my_turn = false;
+            pending_move = -1;
+            screen_drawn = false;
+            
+            std::cout << "\nGame started!\n";
+            std::cout << "You are playing as " << my_piece << "\n";
+            std::cout << "Opponent: " << opponent_name << "\n";
+            std::cout << "Waiting for game to begin...\n";
+        }
+        else if (f.opcode == OP_YOUR_TURN) {
+            my_turn = true;
+            hints = (f.length == LEGAL_MASK_PAYLOAD_SIZE) ? get_u64(f.payload) : game->get_valid_moves(my_piece);
+            render_game();
+        }
+        else if (f.opcode == OP_OPPONENT_TURN) {
+            my_turn = false;
+            render_game();
+        }
+        else if (f.opcode == OP_INVALID) {
+            // server 不接受：收回本地先下的那一步，重新輸入
+            pending_move = -1;
+            my_turn = true;
+            if (f.length == 1 && f.payload[0] == INVALID_FORMAT) {
+                message = "Error: Invalid position format. Please try again.";
+            } else {
+                message = "Error: Invalid move. Please try again.";
+            }
+            render_game();
+        }
+        else if (f.opcode == OP_SKIP) {
+            message = "You have no valid moves. Skipping your turn...";
+            render_game();
+        }
+        else if (f.opcode == OP_OPPONENT_SKIP) {
+            message = opponent_name + " has no valid moves. Skipping...";
+            render_game();
+        }
+        else if (f.opcode == OP_END && f.length == 1 + BOARD_PAYLOAD_SIZE) {
+            set_board(f.payload + 1);
+            my_turn = false;
+            pending_move = -1;
+            message.clear();
+            render_game();
+            finish(result_text(game->get_result()));
+            return false;
+        }
+        else if (f.opcode == OP_OPPONENT_DISCONNECT) {
+            finish("Opponent disconnected. You win!\n");
+            return false;
+        }
+        return true;
     }
     
 public:
@@ -65,6 +363,13 @@ public:
         sock = -1;
         game = new Game();
         my_piece = ' ';
+        resync_pending = false;
+        hints = 0;
+        my_turn = false;
+        pending_move = -1;
+        stdin_open = true;
+        screen_drawn = false;
+        prompt_shown = false;
     }
     
     ~Client() {//解構子
@@ -95,101 +400,145 @@ public:
         
         std::cout << "Connected to server " << server_ip << ":" << server_port << "\n";
         
-        std::cout << "Enter your name: ";
-        std::getline(std::cin, player_name);
-        send_message(player_name);
+        uint8_t preamble[PREAMBLE_SIZE];
+        write_preamble(preamble);
+        send(sock, preamble, sizeof(preamble), MSG_NOSIGNAL);
+        return true;
+    }
+    
+    bool send_hello(bool practice) {
+        std::cout << "Enter your name: " << std::flush;
+        if (!read_line(player_name)) {
+            std::cout << "\nInput closed\n";
+            return false;
+        }
+        if (player_name.size() > MAX_NAME_LENGTH) {
+            player_name.resize(MAX_NAME_LENGTH);
+        }
         
+        // 練習模式直接和 server 上的電腦對戰
+        send_frame(practice ? OP_HELLO_PRACTICE : OP_HELLO, player_name.data(), player_name.size());
         return true;
     }
     
-    void play() {
+    // 續局：token 是開局時印出的 24 個十六進位字元（對局編號 8 個、秘密值 16 個）
+    bool send_resume(const std::string& token) {
+        if (token.size() != 2 * RESUME_TOKEN_SIZE ||
+            token.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos) {
+            std::cerr << "Invalid resume token\n";
+            return false;
+        }
+        uint8_t payload[RESUME_TOKEN_SIZE];
+        put_u32(payload, (uint32_t)strtoul(token.substr(0, 8).c_str(), NULL, 16));
+        put_u64(payload + 4, (uint64_t)strtoull(token.substr(8).c_str(), NULL, 16));
+        send_frame(OP_RESUME, payload, sizeof(payload));
+        return true;
+    }
+    
+    // 觀戰：match_id 為 0 時看最新開始的對局
+    void watch(uint32_t match_id) {
+        uint8_t payload[4];
+        put_u32(payload, match_id);
+        send_frame(OP_WATCH, payload, sizeof(payload));
+        
+        std::string black_name, white_name;
         while (true) {
-            std::string msg = receive_message();
-            if (msg.empty()) {
+            Frame f;
+            if (!receive_frame(f)) {
                 std::cout << "Connection lost\n";
-                break;
+                return;
             }
             
-            std::vector<std::string> parts = split(msg, ':');
-            if (parts.empty()) continue;
-            
-            std::string cmd = parts[0];
-            
-            if (cmd == "WAIT") {
-                std::cout << parts[1] << "\n";
+            if (f.opcode == OP_WATCH_FAILED) {
+                std::cout << "No such match\n";
+                return;
             }
-            else if (cmd == "START") {
-                opponent_name = parts[1];
-                my_piece = parts[2][0];
-                
-                std::cout << "\nGame started!\n";
-                std::cout << "You are playing as " << my_piece << "\n";
-                std::cout << "Opponent: " << opponent_name << "\n";
-                std::cout << "Waiting for game to begin...\n";
-            }
-            else if (cmd == "YOUR_TURN") {
-                game->set_board_state(parts[1]);
-                display_board(true);
-                
-                // 讀取玩家輸入並發送
-                bool move_sent = false;
-                while (!move_sent) {
-                    std::cout << "\nEnter your step. (ex. a1): ";
-                    std::string move;
-                    std::getline(std::cin, move);
-                    
-                    send_message(move);
-                    
-                    // 等待 server 回應
-                    std::string response = receive_message();
-                    std::vector<std::string> resp_parts = split(response, ':');
-                    
-                    if (resp_parts[0] == "INVALID") {
-                        std::cout << "Error: " << resp_parts[1] << ". Please try again.\n";
-                    } else if (resp_parts[0] == "MOVE_OK") {
-                        move_sent = true;
-                    }
+            if (f.opcode == OP_WATCH_START && f.length >= 4 + BOARD_PAYLOAD_SIZE + 2) {
+                const uint8_t* p = f.payload + 4 + BOARD_PAYLOAD_SIZE;
+                const uint8_t* end = f.payload + f.length;
+                size_t black_length = std::min((size_t)p[0], (size_t)(end - p - 1));
+                black_name = std::string((const char*)p + 1, black_length);
+                p += 1 + black_length;
+                if (p < end) {
+                    white_name = std::string((const char*)p + 1, std::min((size_t)p[0], (size_t)(end - p - 1)));
                 }
+                set_board(f.payload + 4);
+                resync_pending = false;
+                std::cout << "Watching match #" << get_u32(f.payload) << "\n";
+            } else if (f.opcode == OP_END && f.length == 1 + BOARD_PAYLOAD_SIZE) {
+                set_board(f.payload + 1);
+                render(*game, black_name + " (X)    " + white_name + " (O)", "(spectating)", 0);
+                finish(result_text(f.payload[0] == RESULT_X_WINS ? black_name + " (X) wins!" :
+                                   f.payload[0] == RESULT_O_WINS ? white_name + " (O) wins!" : std::string("Draw!")));
+                return;
+            } else if (!apply_update(f) || f.opcode == OP_CHECKSUM) {
+                continue;
             }
-            else if (cmd == "OPPONENT_TURN") {
-                game->set_board_state(parts[1]);
-                display_board(false);
-            }
-            else if (cmd == "SKIP") {
-                std::cout << "\nYou have no valid moves. Skipping your turn...\n";
-                game->set_board_state(parts[1]);
-                sleep(2);
+            
+            // 觀眾不能下棋，兩邊都不標示可下的位置
+            render(*game, black_name + " (X)    " + white_name + " (O)", "(spectating)", 0);
+        }
+    }
+    
+    // 同時等待 server 與鍵盤：玩家輸入時仍繼續處理 server 的訊息（心跳、對手的棋步），
+    // 送出棋步後也不必等 MOVE_OK 才更新畫面
+    void play() {
+        while (true) {
+            struct pollfd fds[2];
+            fds[0].fd = sock;
+            fds[0].events = POLLIN;
+            fds[1].fd = stdin_open ? STDIN_FILENO : -1;
+            fds[1].events = POLLIN;
+            if (poll(fds, 2, -1) < 0) {
+                if (errno == EINTR) continue;
+                finish("Connection lost\n");
+                return;
             }
-            else if (cmd == "OPPONENT_SKIP") {
-                std::cout << "\n" << opponent_name << " has no valid moves. Skipping...\n";
-                game->set_board_state(parts[1]);
-                sleep(2);
+            
+            if (fds[1].revents & (POLLIN | POLLHUP | POLLERR)) {
+                read_stdin();
+                if (screen_drawn && !accepting_input() && input.find('\n') != std::string::npos) {
+                    // 還沒輪到自己就按了 Enter：輸入先留著，把提示行連同回顯的換行一起清掉
+                    message = "Please wait for your turn.";
+                    prompt_shown = true;
+                    render_game();
+                }
             }
-            else if (cmd == "END") {
-                game->set_board_state(parts[2]);
-                
-                clear_screen();
-                game->print_board(player_name, opponent_name, my_piece, false);
-                
-                std::cout << "\n===================\n";
-                std::cout << "Game Over!\n";
-                std::cout << parts[1] << "\n";
-                std::cout << "Black (X): " << game->get_black_count() << "\n";
-                std::cout << "White (O): " << game->get_white_count() << "\n";
-                std::cout << "===================\n";
-                break;
+            
+            if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+                int valread = read(sock, decoder.write_ptr(), decoder.write_space());
+                if (valread <= 0) {
+                    finish("Connection lost\n");
+                    return;
+                }
+                decoder.commit(valread);
+                Frame f;
+                while (decoder.next(f)) {
+                    if (!handle_frame(f)) return;
+                }
+                if (decoder.is_malformed()) {
+                    finish("Connection lost\n");
+                    return;
+                }
             }
-            else if (cmd == "OPPONENT_DISCONNECT") {
-                std::cout << "\nOpponent disconnected. You win!\n";
-                break;
+            
+            process_input();
+            if (!stdin_open && input.empty() && accepting_input()) {
+                // 輸入已結束，沒辦法再下棋：關閉連線讓 server 知道，對手不必等到時限
+                finish("Input closed, leaving the game\n");
+                close(sock);
+                sock = -1;
+                return;
             }
         }
     }
 };
 
 int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        std::cout << "Usage: " << argv[0] << " <server_ip> <server_port>\n";
+    std::string mode = (argc >= 4) ? argv[3] : "";
+    if (argc < 3 || argc > 5 || (argc >= 4 && mode != "--practice" && mode != "--watch" && mode != "--resume") ||
+        (argc == 5 && mode == "--practice") || (mode == "--resume" && argc != 5)) {
+        std::cout << "Usage: " << argv[0] << " <server_ip> <server_port> [--practice | --watch [match_id] | --resume token]\n";
         return 1;
     }
     
@@ -201,6 +550,20 @@ int main(int argc, char* argv[]) {
         return 1;
     }
     
+    if (mode == "--watch") {
+        client.watch(argc == 5 ? (uint32_t)strtoul(argv[4], NULL, 10) : 0);
+        return 0;
+    }
+    if (mode == "--resume") {
+        if (!client.send_resume(argv[4])) {
+            return 1;
+        }
+        client.play();
+        return 0;
+    }
+    if (!client.send_hello(mode == "--practice")) {
+        return 1;
+    }
     client.play();
     
     return 0;
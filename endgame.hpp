@@ -0,0 +1,460 @@
+#ifndef ENDGAME_HPP
+#define ENDGAME_HPP
+
+#include <stdint.h>
+#include <chrono>
+#include <vector>
+#include "game.hpp"
+
+#define ENDGAME_MAX_EMPTIES 26       // 超過這個空格數不建議求解（時間呈指數成長）
+#define ENDGAME_FASTEST_FIRST 5      // 空格數大於此值時依對手行動力排序（fastest-first）
+#define ENDGAME_LAST_EMPTIES 5       // 空格數小於等於此值時不產生合法位置，直接掃空格
+#define ENDGAME_HASH_EMPTIES 7       // 空格數大於等於此值時使用雜湊表
+#define ENDGAME_ETC_EMPTIES 10       // 空格數大於等於此值時先查子節點的雜湊表（enhanced transposition cutoff）
+#define ENDGAME_HASH_BITS 18         // 雜湊表 2^18 筆（6 MB）
+#define ENDGAME_STABILITY_EMPTIES 7  // 空格數大於等於此值時用穩定子估計分數上限
+#define ENDGAME_NO_MOVE 64
+#define ENDGAME_CORNERS 0x8100000000000081ULL
+#define ENDGAME_X_SQUARES 0x0042000000004200ULL   // 角落斜對面的格子
+#define ENDGAME_CHECK_NODES 4096     // 有期限時每搜尋這麼多個節點看一次時間
+
+struct EndgameResult {
+    int move;          // 位置 row * 8 + col，-1 表示沒有合法位置（pass 或已結束）
+    int score;         // 終局子數差（以 player 的角度）；只判斷勝負時為 -1、0、1
+    uint64_t nodes;
+    double seconds;
+    bool complete;     // 有期限時是否在期限內算完；沒算完時 move 與 score 都不可用
+};
+
+// 殘局完全求解：搜尋到終局為止，回傳精確的子數差
+// 分數與 Game::get_result() 一致，只比較雙方棋子數，空格不計入任何一方
+//
+// 排序：空格多時先下讓對手行動力最少的位置（fastest-first），再參考對手可能的行動力、
+// 角落與 X 格，同分時優先下在空格數為奇數的象限（parity）；最後幾格直接掃描空格，
+// 依 parity、角落、一般格、X 格的順序。
+// 空格多的節點另外記在雜湊表：存完整局面、分數上下界與最佳步，與搜尋窗口無關，
+// 所以同一個 solver 連續求解（例如整盤棋的每一手）時可以繼續沿用。
+// 每個位置有兩筆（bucket），新的結果蓋掉空格數較少、也就是比較容易重算的那一筆。
+class EndgameSolver {
+private:
+    struct Entry {
+        uint64_t own;
+        uint64_t opp;
+        int8_t lower;     // 真正的分數 >= lower
+        int8_t upper;     // 真正的分數 <= upper
+        uint8_t move;
+        uint8_t empties;
+    };
+
+    uint64_t nodes;
+    std::vector<Entry> table;
+
+    // 期限：超過時 aborted 設為 true，每一層不寫雜湊表、直接返回，表中只留下算完的結果
+    bool limited;
+    bool aborted;
+    int check_countdown;
+    std::chrono::steady_clock::time_point deadline;
+
+    // 找到同一個局面就回傳那一筆，否則回傳要被取代的那一筆
+    Entry* entry_for(uint64_t own, uint64_t opp) {
+        uint64_t h = own * 0x9e3779b97f4a7c15ULL ^ (opp + 0x632be59bd9b4e019ULL) * 0xc2b2ae3d27d4eb4fULL;
+        Entry* first = &table[(h >> (64 - ENDGAME_HASH_BITS)) & ~(uint64_t)1];
+        Entry* second = first + 1;
+        if (first->own == own && first->opp == opp) return first;
+        if (second->own == own && second->opp == opp) return second;
+        return (second->empties < first->empties) ? second : first;
+    }
+
+    static int popcount(uint64_t b) { return __builtin_popcountll(b); }
+
+    // 往一個方向夾住的對手棋子；一條線上最多 6 顆，展開成固定次數的位移，不用逐格判斷
+    template <int S>
+    static uint64_t flips_forward(uint64_t m, uint64_t own, uint64_t mask) {
+        uint64_t x = (m << S) & mask;
+        x |= (x << S) & mask;
+        x |= (x << S) & mask;
+        x |= (x << S) & mask;
+        x |= (x << S) & mask;
+        x |= (x << S) & mask;
+        return ((x << S) & own) ? x : 0;
+    }
+
+    template <int S>
+    static uint64_t flips_backward(uint64_t m, uint64_t own, uint64_t mask) {
+        uint64_t x = (m >> S) & mask;
+        x |= (x >> S) & mask;
+        x |= (x >> S) & mask;
+        x |= (x >> S) & mask;
+        x |= (x >> S) & mask;
+        x |= (x >> S) & mask;
+        return ((x >> S) & own) ? x : 0;
+    }
+
+    // 與 Game::compute_flips 相同，只處理 8x8；殘局大部分時間花在這裡
+    static uint64_t compute_flips(int sq, uint64_t own, uint64_t opp) {
+        uint64_t m = 1ULL << sq;
+        uint64_t inner = opp & 0x7e7e7e7e7e7e7e7eULL;   // 水平、斜向不能跨列繞回
+        return flips_forward<1>(m, own, inner) | flips_backward<1>(m, own, inner) |
+               flips_forward<8>(m, own, opp) | flips_backward<8>(m, own, opp) |
+               flips_forward<7>(m, own, inner) | flips_backward<7>(m, own, inner) |
+               flips_forward<9>(m, own, inner) | flips_backward<9>(m, own, inner);
+    }
+
+    static int final_diff(uint64_t own, uint64_t opp) {
+        return popcount(own) - popcount(opp);
+    }
+
+    // 八個方向的相鄰格
+    static uint64_t neighbours(uint64_t b) {
+        uint64_t left = (b >> 1) & 0x7f7f7f7f7f7f7f7fULL;
+        uint64_t right = (b << 1) & 0xfefefefefefefefeULL;
+        uint64_t row = b | left | right;
+        return (row | (row << 8) | (row >> 8)) & ~b;
+    }
+
+    // 空格數為奇數的象限集合
+    static uint64_t odd_regions(uint64_t empty) {
+        static const uint64_t quadrants[4] = {
+            0x000000000f0f0f0fULL, 0x00000000f0f0f0f0ULL,
+            0x0f0f0f0f00000000ULL, 0xf0f0f0f000000000ULL
+        };
+        uint64_t odd = 0;
+        for (int q = 0; q < 4; q++) {
+            if (popcount(empty & quadrants[q]) & 1) odd |= quadrants[q];
+        }
+        return odd;
+    }
+
+    // 四個方向上已經填滿的線（整條線沒有空格，這個方向不可能再翻轉）
+    struct FullLines {
+        uint64_t horizontal, vertical, diag7, diag9;
+    };
+
+    // 兩個斜向各 15 條線
+    struct Diagonals {
+        uint64_t diag7[15];
+        uint64_t diag9[15];
+
+        Diagonals() {
+            for (int i = 0; i < 15; i++) diag7[i] = diag9[i] = 0;
+            for (int sq = 0; sq < 64; sq++) {
+                int row = sq / 8, col = sq % 8;
+                diag7[row + col] |= 1ULL << sq;
+                diag9[row - col + 7] |= 1ULL << sq;
+            }
+        }
+    };
+
+    static FullLines full_lines(uint64_t filled) {
+        static const Diagonals diagonals;
+        const uint64_t* diag7 = diagonals.diag7;
+        const uint64_t* diag9 = diagonals.diag9;
+
+        FullLines lines = {0, 0, 0, 0};
+        for (int i = 0; i < 8; i++) {
+            uint64_t row = 0xffULL << (8 * i);
+            uint64_t col = 0x0101010101010101ULL << i;
+            if ((filled & row) == row) lines.horizontal |= row;
+            if ((filled & col) == col) lines.vertical |= col;
+        }
+        for (int i = 0; i < 15; i++) {
+            if ((filled & diag7[i]) == diag7[i]) lines.diag7 |= diag7[i];
+            if ((filled & diag9[i]) == diag9[i]) lines.diag9 |= diag9[i];
+        }
+        return lines;
+    }
+
+    // 穩定子：四個方向都「整條線已滿、靠著邊界、或旁邊是自己的穩定子」就不可能再被翻轉
+    static uint64_t stable_discs(uint64_t own, uint64_t opp) {
+        const uint64_t FRAME = 0xff818181818181ffULL;
+        FullLines lines = full_lines(own | opp);
+        uint64_t stable = 0;
+        uint64_t previous;
+        do {
+            previous = stable;
+            uint64_t h = lines.horizontal | 0x8181818181818181ULL |
+                         ((stable << 1) & 0xfefefefefefefefeULL) | ((stable >> 1) & 0x7f7f7f7f7f7f7f7fULL);
+            uint64_t v = lines.vertical | 0xff000000000000ffULL | (stable << 8) | (stable >> 8);
+            uint64_t d7 = lines.diag7 | FRAME |
+                          ((stable << 7) & 0x7f7f7f7f7f7f7f7fULL) | ((stable >> 7) & 0xfefefefefefefefeULL);
+            uint64_t d9 = lines.diag9 | FRAME |
+                          ((stable << 9) & 0xfefefefefefefefeULL) | ((stable >> 9) & 0x7f7f7f7f7f7f7f7fULL);
+            stable = own & h & v & d7 & d9;
+        } while (stable != previous);
+        return stable;
+    }
+
+    // 只剩一格：不用產生合法位置，直接看雙方能否在這格下棋
+    int solve_last(uint64_t own, uint64_t opp, int sq) {
+        nodes++;
+        int diff = final_diff(own, opp);
+        uint64_t flips = compute_flips(sq, own, opp);
+        if (flips != 0) {
+            return diff + 1 + 2 * popcount(flips);
+        }
+        nodes++;
+        flips = compute_flips(sq, opp, own);
+        if (flips != 0) {
+            return diff - 1 - 2 * popcount(flips);
+        }
+        return diff;
+    }
+
+    // 剩下幾格：依 parity 順序逐一嘗試空格，省去產生合法位置的成本；
+    // 同一組裡先試角落、最後試 X 格
+    int solve_shallow(uint64_t own, uint64_t opp, int alpha, int beta, bool passed) {
+        uint64_t empty = ~(own | opp);
+        if (popcount(empty) == 1) {
+            return solve_last(own, opp, __builtin_ctzll(empty));
+        }
+        nodes++;
+
+        uint64_t odd = odd_regions(empty);
+        uint64_t order[6] = {
+            empty & odd & ENDGAME_CORNERS, empty & odd & ~(ENDGAME_CORNERS | ENDGAME_X_SQUARES), empty & odd & ENDGAME_X_SQUARES,
+            empty & ~odd & ENDGAME_CORNERS, empty & ~odd & ~(ENDGAME_CORNERS | ENDGAME_X_SQUARES), empty & ~odd & ENDGAME_X_SQUARES
+        };
+        int best = -65;
+        bool moved = false;
+
+        for (int k = 0; k < 6; k++) {
+            for (uint64_t b = order[k]; b; b &= b - 1) {
+                int sq = __builtin_ctzll(b);
+                uint64_t flips = compute_flips(sq, own, opp);
+                if (flips == 0) continue;
+                moved = true;
+
+                uint64_t next_own = own | flips | (1ULL << sq);
+                uint64_t next_opp = opp & ~flips;
+                int score = -solve_shallow(next_opp, next_own, -beta, -alpha, false);
+                if (score > best) {
+                    best = score;
+                    if (score > alpha) {
+                        alpha = score;
+                        if (alpha >= beta) return best;
+                    }
+                }
+            }
+        }
+
+        if (!moved) {
+            if (passed) {
+                return final_diff(own, opp);
+            }
+            return -solve_shallow(opp, own, -beta, -alpha, true);
+        }
+        return best;
+    }
+
+    int solve(uint64_t own, uint64_t opp, int alpha, int beta, bool passed, int* best_move) {
+        uint64_t empty = ~(own | opp);
+        int empties = popcount(empty);
+        if (limited && --check_countdown <= 0) {
+            check_countdown = ENDGAME_CHECK_NODES;
+            if (std::chrono::steady_clock::now() >= deadline) aborted = true;
+        }
+        if (aborted) return 0;
+        if (empties <= ENDGAME_LAST_EMPTIES && best_move == NULL) {
+            return solve_shallow(own, opp, alpha, beta, passed);
+        }
+        nodes++;
+
+        uint64_t moves = Game::generate_moves(own, opp);
+        if (moves == 0) {
+            if (passed) {
+                return final_diff(own, opp);
+            }
+            return -solve(opp, own, -beta, -alpha, true, NULL);
+        }
+
+        // 對手的穩定子不會變成自己的，分數最多 64 - 2 x 穩定子數；
+        // 對手的棋子全部穩定也不到 alpha 時不必計算
+        if (empties >= ENDGAME_STABILITY_EMPTIES && best_move == NULL && 64 - 2 * popcount(opp) <= alpha) {
+            int bound = 64 - 2 * popcount(stable_discs(opp, own));
+            if (bound <= alpha) return bound;
+        }
+
+        Entry* entry = NULL;
+        int hash_move = ENDGAME_NO_MOVE;
+        if (empties >= ENDGAME_HASH_EMPTIES) {
+            entry = entry_for(own, opp);
+            if (entry->own == own && entry->opp == opp) {
+                hash_move = entry->move;
+                if (best_move == NULL) {
+                    if (entry->lower >= beta) return entry->lower;
+                    if (entry->upper <= alpha) return entry->upper;
+                    if (entry->lower == entry->upper) return entry->lower;
+                    if (entry->lower > alpha) alpha = entry->lower;
+                    if (entry->upper < beta) beta = entry->upper;
+                }
+            }
+        }
+        int alpha_orig = alpha;
+        int beta_orig = beta;
+
+        // 產生並排序所有子節點；雜湊表記錄的最佳步排第一
+        int squares[32];
+        uint64_t flip_list[32];
+        int keys[32];
+        int n = 0;
+        uint64_t odd = odd_regions(empty);
+
+        for (uint64_t b = moves; b; b &= b - 1) {
+            int sq = __builtin_ctzll(b);
+            uint64_t flips = compute_flips(sq, own, opp);
+            int key = (odd >> sq) & 1 ? 0 : 1;
+            if (sq == hash_move) {
+                key = -1;
+            } else if (empties > ENDGAME_FASTEST_FIRST) {
+                // 對手的行動力（角落算兩次）為主，其次是對手可能的行動力（自己棋子旁的空格），
+                // 自己下角落優先、下 X 格延後
+                uint64_t next_own = own | flips | (1ULL << sq);
+                uint64_t next_opp = opp & ~flips;
+                uint64_t reply = Game::generate_moves(next_opp, next_own);
+                key += 8 * (popcount(reply) + popcount(reply & ENDGAME_CORNERS));
+                key += popcount(neighbours(next_own) & empty & ~(1ULL << sq));
+                if ((1ULL << sq) & ENDGAME_CORNERS) key -= 8;
+                if ((1ULL << sq) & ENDGAME_X_SQUARES) key += 8;
+            }
+
+            int i = n++;
+            while (i > 0 && keys[i - 1] > key) {
+                squares[i] = squares[i - 1];
+                flip_list[i] = flip_list[i - 1];
+                keys[i] = keys[i - 1];
+                i--;
+            }
+            squares[i] = sq;
+            flip_list[i] = flips;
+            keys[i] = key;
+        }
+
+        // 任何一個子節點已知的上限就足以截斷時，不必展開（enhanced transposition cutoff）
+        if (empties >= ENDGAME_ETC_EMPTIES && best_move == NULL) {
+            for (int i = 0; i < n; i++) {
+                uint64_t next_own = own | flip_list[i] | (1ULL << squares[i]);
+                uint64_t next_opp = opp & ~flip_list[i];
+                Entry* child = entry_for(next_opp, next_own);
+                if (child->own == next_opp && child->opp == next_own && -child->upper >= beta) {
+                    return -child->upper;
+                }
+            }
+        }
+
+        // principal variation search：第一步用完整窗口，其餘先用 null window 驗證
+        int best = -65;
+        int best_square = squares[0];
+        for (int i = 0; i < n; i++) {
+            uint64_t next_own = own | flip_list[i] | (1ULL << squares[i]);
+            uint64_t next_opp = opp & ~flip_list[i];
+            int score;
+            if (i == 0) {
+                score = -solve(next_opp, next_own, -beta, -alpha, false, NULL);
+            } else {
+                score = -solve(next_opp, next_own, -alpha - 1, -alpha, false, NULL);
+                if (score > alpha && score < beta) {
+                    score = -solve(next_opp, next_own, -beta, -score, false, NULL);
+                }
+            }
+            if (aborted) return 0;
+
+            if (score > best) {
+                best = score;
+                best_square = squares[i];
+                if (score > alpha) {
+                    alpha = score;
+                    if (alpha >= beta) break;
+                }
+            }
+        }
+
+        if (best_move != NULL) *best_move = best_square;
+        if (entry != NULL) {
+            if (entry->own != own || entry->opp != opp || entry->empties < empties) {
+                entry->own = own;
+                entry->opp = opp;
+                entry->lower = -64;
+                entry->upper = 64;
+                entry->empties = (uint8_t)empties;
+            }
+            if (best > alpha_orig && best < beta_orig) {
+                entry->lower = entry->upper = (int8_t)best;
+            } else if (best >= beta_orig) {
+                entry->lower = (int8_t)best;
+            } else {
+                entry->upper = (int8_t)best;
+            }
+            entry->move = (uint8_t)best_square;
+        }
+        return best;
+    }
+
+public:
+    EndgameSolver()
+        : nodes(0), table((size_t)1 << ENDGAME_HASH_BITS), limited(false), aborted(false), check_countdown(0) {}
+
+    // 求出精確的子數差；win_loss_draw 為 true 時只判斷勝負（較快），分數為 -1、0、1
+    EndgameResult solve(const Game& game, char player, bool win_loss_draw = false) {
+        limited = false;
+        return run(game, player, win_loss_draw);
+    }
+
+    // 同上，但超過 limit 就放棄（complete 為 false），呼叫端改用一般搜尋
+    EndgameResult solve(const Game& game, char player, std::chrono::steady_clock::time_point limit) {
+        limited = true;
+        deadline = limit;
+        return run(game, player, false);
+    }
+
+    static int empties(const Game& game) {
+        return 64 - popcount(game.get_black_board() | game.get_white_board());
+    }
+
+private:
+    EndgameResult run(const Game& game, char player, bool win_loss_draw) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        nodes = 0;
+        aborted = false;
+        check_countdown = ENDGAME_CHECK_NODES;
+
+        uint64_t own = (player == 'X') ? game.get_black_board() : game.get_white_board();
+        uint64_t opp = (player == 'X') ? game.get_white_board() : game.get_black_board();
+
+        EndgameResult result;
+        result.move = -1;
+        bool can_move = Game::generate_moves(own, opp) != 0;
+
+        if (win_loss_draw) {
+            int score = solve(own, opp, -1, 1, false, can_move ? &result.move : NULL);
+            result.score = (score > 0) - (score < 0);
+        } else {
+            // 以一連串 null window 逼近精確分數（MTD(f)），比完整窗口快很多；
+            // 每次試探得到的上下界都留在雜湊表，下一次試探直接沿用
+            int lower = -64;
+            int upper = 64;
+            int score = 0;
+            while (lower < upper) {
+                int beta = (score == lower) ? score + 1 : score;
+                int move = -1;
+                score = solve(own, opp, beta - 1, beta, false, can_move ? &move : NULL);
+                if (aborted) break;
+                if (score >= beta) {
+                    lower = score;
+                    result.move = move;      // 這一步至少能拿到 lower
+                } else {
+                    upper = score;
+                    if (result.move < 0) result.move = move;
+                }
+            }
+            result.score = lower;
+        }
+
+        result.complete = !aborted;
+        if (aborted) result.move = -1;
+        result.nodes = nodes;
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return result;
+    }
+};
+
+#endif // ENDGAME_HPP
@@ -0,0 +1,337 @@
+#ifndef EVAL_HPP
+#define EVAL_HPP
+
+#include <stdint.h>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <iostream>
+#include "game.hpp"
+#include "symmetry.hpp"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define EVAL_HAVE_AVX2 1
+#else
+#define EVAL_HAVE_AVX2 0
+#endif
+
+// 樣式評估：把棋盤切成邊、角、直線與對角線等樣式，每個樣式的每種排列（每格空、己方、對方，
+// 三進位編號）各有一個權重，加上行動力與奇偶性兩項。權重由檔案載入，依進行階段分成幾組。
+// 每個樣式在 8 種對稱的棋盤上各取一次（共 EVAL_FEATURE_COUNT 個特徵），所以評估值不受旋轉、鏡射影響。
+//
+// 特徵編號直接由 bitboard 算出：樣式在（對稱後的）棋盤上的格子以幾組 (右移, 遮罩) 收集成二進位數，
+// 再查表轉成三進位。支援 AVX2 的 CPU 一次處理 4 種對稱，其他 CPU（包括 ARM）用一般的寫法。
+//
+// 權重檔（數值為本機 byte order）：
+//   檔頭 16 bytes：'R' 'V' 'E' 'V'、版本、階段數、每階段的權重數（皆為 uint32_t）
+//   之後每個階段依序為所有樣式的權重、行動力權重、奇偶性權重（int16_t，單位為 1/EVAL_SCALE 分）
+#define EVAL_MAGIC "RVEV"
+#define EVAL_VERSION 1
+#define EVAL_PATTERN_COUNT 11
+#define EVAL_FEATURE_COUNT (EVAL_PATTERN_COUNT * SYMMETRY_COUNT)
+#define EVAL_MAX_PATTERN_SIZE 10
+#define EVAL_PATTERN_WEIGHTS 167265          // 各樣式 3^格數 的總和
+#define EVAL_MOBILITY (EVAL_PATTERN_WEIGHTS)        // 每階段權重中行動力的位置
+#define EVAL_PARITY (EVAL_PATTERN_WEIGHTS + 1)      // 每階段權重中奇偶性的位置
+#define EVAL_PHASE_SIZE (EVAL_PATTERN_WEIGHTS + 2)
+#define EVAL_PHASES 4                        // 以已下的步數分成 4 個階段
+#define EVAL_SCALE 16
+
+// 樣式的一組收集方式：(b >> shift) & mask 放進二進位編號的對應位置
+struct PatternTerm {
+    int shift;
+    uint64_t mask;
+};
+
+struct PatternInfo {
+    const char* name;
+    int size;          // 格數
+    int first_term;
+    int term_count;
+};
+
+// 樣式都定義在 a8 角附近（bit = row * 8 + col，row 0 為第 8 列）
+static const PatternTerm EVAL_TERMS[] = {
+    {0, 0xff}, {1, 0x100}, {5, 0x200},                   // 邊加兩個 X 位置
+    {0, 0x7}, {5, 0x38}, {10, 0x1c0},                    // 角落 3x3
+    {0, 0x1f}, {3, 0x3e0},                               // 角落 2x5
+    {8, 0xff},                                           // 第 2 列
+    {16, 0xff},                                          // 第 3 列
+    {24, 0xff},                                          // 第 4 列
+    {0, 0x1}, {8, 0x2}, {16, 0x4}, {24, 0x8}, {32, 0x10}, {40, 0x20}, {48, 0x40}, {56, 0x80},   // 主對角線
+    {1, 0x1}, {9, 0x2}, {17, 0x4}, {25, 0x8}, {33, 0x10}, {41, 0x20}, {49, 0x40},               // 7 格對角線
+    {2, 0x1}, {10, 0x2}, {18, 0x4}, {26, 0x8}, {34, 0x10}, {42, 0x20},                          // 6 格對角線
+    {3, 0x1}, {11, 0x2}, {19, 0x4}, {27, 0x8}, {35, 0x10},                                      // 5 格對角線
+    {4, 0x1}, {12, 0x2}, {20, 0x4}, {28, 0x8}                                                   // 4 格對角線
+};
+
+static const PatternInfo EVAL_PATTERNS[EVAL_PATTERN_COUNT] = {
+    {"edge+2x", 10, 0, 3},
+    {"corner3x3", 9, 3, 3},
+    {"corner2x5", 10, 6, 2},
+    {"line2", 8, 8, 1},
+    {"line3", 8, 9, 1},
+    {"line4", 8, 10, 1},
+    {"diag8", 8, 11, 8},
+    {"diag7", 7, 19, 7},
+    {"diag6", 6, 26, 6},
+    {"diag5", 5, 32, 5},
+    {"diag4", 4, 37, 4}
+};
+
+static inline uint32_t pattern_bits(uint64_t b, const PatternInfo& p) {
+    uint64_t bits = 0;
+    for (int t = p.first_term; t < p.first_term + p.term_count; t++) {
+        bits |= (b >> EVAL_TERMS[t].shift) & EVAL_TERMS[t].mask;
+    }
+    return (uint32_t)bits;
+}
+
+// 已下的步數 0..60 對應到階段 0..EVAL_PHASES-1
+static inline int eval_phase(int empties) {
+    int phase = (60 - empties) * EVAL_PHASES / 61;
+    return phase < 0 ? 0 : phase;
+}
+
+#if EVAL_HAVE_AVX2
+// 一次算出 b 的 4 種對稱：lo 為對稱 0..3，hi 為 4..7（再左右翻轉），與 transform_board 相同
+__attribute__((target("avx2")))
+static inline void symmetries_avx2(uint64_t b, __m256i& lo, __m256i& hi) {
+    const __m256i k1 = _mm256_set1_epi64x(0x5500550055005500LL);
+    const __m256i k2 = _mm256_set1_epi64x(0x3333000033330000LL);
+    const __m256i k4 = _mm256_set1_epi64x(0x0f0f0f0f00000000LL);
+    __m256i v = _mm256_set1_epi64x((long long)b);
+
+    // 轉置（對稱 1、3）
+    __m256i d = v;
+    __m256i t = _mm256_and_si256(k4, _mm256_xor_si256(d, _mm256_slli_epi64(d, 28)));
+    d = _mm256_xor_si256(d, _mm256_xor_si256(t, _mm256_srli_epi64(t, 28)));
+    t = _mm256_and_si256(k2, _mm256_xor_si256(d, _mm256_slli_epi64(d, 14)));
+    d = _mm256_xor_si256(d, _mm256_xor_si256(t, _mm256_srli_epi64(t, 14)));
+    t = _mm256_and_si256(k1, _mm256_xor_si256(d, _mm256_slli_epi64(d, 7)));
+    d = _mm256_xor_si256(d, _mm256_xor_si256(t, _mm256_srli_epi64(t, 7)));
+    v = _mm256_blend_epi32(v, d, 0xcc);
+
+    // 上下翻轉（對稱 2、3）：每個 64-bit 內的 byte 反序
+    const __m256i reverse = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                             7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    lo = _mm256_blend_epi32(v, _mm256_shuffle_epi8(v, reverse), 0xf0);
+
+    // 左右翻轉（對稱 4..7）：每個 byte 內的 bit 反序
+    const __m256i m1 = _mm256_set1_epi64x(0x5555555555555555LL);
+    const __m256i m2 = _mm256_set1_epi64x(0x3333333333333333LL);
+    const __m256i m4 = _mm256_set1_epi64x(0x0f0f0f0f0f0f0f0fLL);
+    __m256i m = lo;
+    m = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi64(m, 1), m1), _mm256_slli_epi64(_mm256_and_si256(m, m1), 1));
+    m = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi64(m, 2), m2), _mm256_slli_epi64(_mm256_and_si256(m, m2), 2));
+    m = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi64(m, 4), m4), _mm256_slli_epi64(_mm256_and_si256(m, m4), 4));
+    hi = m;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i pattern_bits_avx2(__m256i b, const PatternInfo& p) {
+    __m256i bits = _mm256_setzero_si256();
+    for (int t = p.first_term; t < p.first_term + p.term_count; t++) {
+        __m256i shifted = _mm256_srl_epi64(b, _mm_cvtsi32_si128(EVAL_TERMS[t].shift));
+        bits = _mm256_or_si256(bits, _mm256_and_si256(shifted, _mm256_set1_epi64x((long long)EVAL_TERMS[t].mask)));
+    }
+    return bits;
+}
+
+// 4 種對稱的二進位編號轉成三進位後加上樣式的起點
+__attribute__((target("avx2")))
+static inline __m128i pattern_index_avx2(const int* ternary, __m256i own, __m256i opp, int offset) {
+    __m128i a = _mm256_i64gather_epi32(ternary, own, 4);
+    __m128i b = _mm256_i64gather_epi32(ternary, opp, 4);
+    return _mm_add_epi32(_mm_add_epi32(a, _mm_add_epi32(b, b)), _mm_set1_epi32(offset));
+}
+
+__attribute__((target("avx2")))
+static void eval_features_avx2(const int* ternary, const int* offsets, uint64_t own, uint64_t opp,
+                               uint32_t* features) {
+    __m256i own_lo, own_hi, opp_lo, opp_hi;
+    symmetries_avx2(own, own_lo, own_hi);
+    symmetries_avx2(opp, opp_lo, opp_hi);
+    for (int p = 0; p < EVAL_PATTERN_COUNT; p++) {
+        const PatternInfo& info = EVAL_PATTERNS[p];
+        __m128i lo = pattern_index_avx2(ternary, pattern_bits_avx2(own_lo, info), pattern_bits_avx2(opp_lo, info),
+                                        offsets[p]);
+        __m128i hi = pattern_index_avx2(ternary, pattern_bits_avx2(own_hi, info), pattern_bits_avx2(opp_hi, info),
+                                        offsets[p]);
+        _mm256_storeu_si256((__m256i*)(features + p * SYMMETRY_COUNT), _mm256_set_m128i(hi, lo));
+    }
+}
+#endif
+
+class PatternEvaluator {
+private:
+    std::vector<int16_t> weights;                 // EVAL_PHASES * EVAL_PHASE_SIZE
+    int ternary[1 << EVAL_MAX_PATTERN_SIZE];      // 二進位編號 -> 同樣位數的三進位編號
+    int offsets[EVAL_PATTERN_COUNT];              // 每個樣式的權重在一個階段中的起點
+    bool vectorized;
+
+    // 預設權重：由 Searcher 的位置權重換算（每格的權重平均分給涵蓋它的特徵），行動力每步 10 分，
+    // 奇偶性只在後半盤給一點分數；作為沒有訓練過的權重檔時的起點
+    void set_default_weights() {
+        static const int square_weights[64] = {
+            100, -20,  10,   5,   5,  10, -20, 100,
+            -20, -50,  -2,  -2,  -2,  -2, -50, -20,
+             10,  -2,  -1,  -1,  -1,  -1,  -2,  10,
+              5,  -2,  -1,  -1,  -1,  -1,  -2,   5,
+              5,  -2,  -1,  -1,  -1,  -1,  -2,   5,
+             10,  -2,  -1,  -1,  -1,  -1,  -2,  10,
+            -20, -50,  -2,  -2,  -2,  -2, -50, -20,
+            100, -20,  10,   5,   5,  10, -20, 100
+        };
+        static const int parity_weights[EVAL_PHASES] = {0, 0, 1, 2};
+
+        int squares[EVAL_PATTERN_COUNT][EVAL_MAX_PATTERN_SIZE];
+        int cover[64] = {0};
+        for (int p = 0; p < EVAL_PATTERN_COUNT; p++) {
+            pattern_squares(EVAL_PATTERNS[p], squares[p]);
+            for (int k = 0; k < EVAL_PATTERNS[p].size; k++) cover[squares[p][k]] += SYMMETRY_COUNT;
+        }
+
+        weights.assign(EVAL_PHASES * EVAL_PHASE_SIZE, 0);
+        for (int phase = 0; phase < EVAL_PHASES; phase++) {
+            int16_t* w = &weights[phase * EVAL_PHASE_SIZE];
+            for (int p = 0; p < EVAL_PATTERN_COUNT; p++) {
+                int count = 1;
+                for (int k = 0; k < EVAL_PATTERNS[p].size; k++) count *= 3;
+                for (int index = 0; index < count; index++) {
+                    double value = 0;
+                    int rest = index;
+                    for (int k = 0; k < EVAL_PATTERNS[p].size; k++, rest /= 3) {
+                        int sq = squares[p][k];
+                        double share = (double)square_weights[sq] * EVAL_SCALE / cover[sq];
+                        if (rest % 3 == 1) value += share;
+                        else if (rest % 3 == 2) value -= share;
+                    }
+                    w[offsets[p] + index] = (int16_t)lround(value);
+                }
+            }
+            w[EVAL_MOBILITY] = 10 * EVAL_SCALE;
+            w[EVAL_PARITY] = parity_weights[phase] * EVAL_SCALE;
+        }
+    }
+
+public:
+    PatternEvaluator() {
+        for (int bits = 0; bits < (1 << EVAL_MAX_PATTERN_SIZE); bits++) {
+            int value = 0;
+            for (int k = EVAL_MAX_PATTERN_SIZE - 1; k >= 0; k--) value = value * 3 + ((bits >> k) & 1);
+            ternary[bits] = value;
+        }
+        int offset = 0;
+        for (int p = 0; p < EVAL_PATTERN_COUNT; p++) {
+            offsets[p] = offset;
+            int count = 1;
+            for (int k = 0; k < EVAL_PATTERNS[p].size; k++) count *= 3;
+            offset += count;
+        }
+#if EVAL_HAVE_AVX2
+        vectorized = __builtin_cpu_supports("avx2");
+#else
+        vectorized = false;
+#endif
+        set_default_weights();
+    }
+
+    // 樣式第 k 位對應的格子（a8 角附近的原始位置）
+    static void pattern_squares(const PatternInfo& p, int* squares) {
+        for (int t = p.first_term; t < p.first_term + p.term_count; t++) {
+            for (uint64_t m = EVAL_TERMS[t].mask; m; m &= m - 1) {
+                int k = __builtin_ctzll(m);
+                squares[k] = k + EVAL_TERMS[t].shift;
+            }
+        }
+    }
+
+    bool load(const std::string& path) {
+        FILE* f = fopen(path.c_str(), "rb");
+        if (f == NULL) {
+            std::cerr << "Cannot open weights " << path << "\n";
+            return false;
+        }
+        char magic[4];
+        uint32_t header[3];
+        std::vector<int16_t> loaded(EVAL_PHASES * EVAL_PHASE_SIZE);
+        bool ok = fread(magic, 1, 4, f) == 4 && fread(header, sizeof(uint32_t), 3, f) == 3 &&
+                  memcmp(magic, EVAL_MAGIC, 4) == 0 && header[0] == EVAL_VERSION &&
+                  header[1] == EVAL_PHASES && header[2] == EVAL_PHASE_SIZE &&
+                  fread(&loaded[0], sizeof(int16_t), loaded.size(), f) == loaded.size() &&
+                  fgetc(f) == EOF;
+        fclose(f);
+        if (!ok) {
+            std::cerr << path << ": not a weights file (or a different pattern set)\n";
+            return false;
+        }
+        weights.swap(loaded);
+        return true;
+    }
+
+    bool save(const std::string& path) const {
+        FILE* f = fopen(path.c_str(), "wb");
+        if (f == NULL) {
+            std::cerr << "Cannot create " << path << "\n";
+            return false;
+        }
+        uint32_t header[3] = {EVAL_VERSION, EVAL_PHASES, EVAL_PHASE_SIZE};
+        bool ok = fwrite(EVAL_MAGIC, 1, 4, f) == 4 && fwrite(header, sizeof(uint32_t), 3, f) == 3 &&
+                  fwrite(&weights[0], sizeof(int16_t), weights.size(), f) == weights.size();
+        ok = (fclose(f) == 0) && ok;
+        if (!ok) std::cerr << "Write to " << path << " failed\n";
+        return ok;
+    }
+
+    // 關掉時一律用一般的寫法（比較與驗證用）；CPU 不支援 AVX2 時開不起來
+    void set_vectorized(bool enable) {
+#if EVAL_HAVE_AVX2
+        vectorized = enable && __builtin_cpu_supports("avx2");
+#else
+        (void)enable;
+#endif
+    }
+
+    bool is_vectorized() const { return vectorized; }
+
+    // 以 own 的角度算出所有特徵在一個階段權重中的位置，依樣式、再依對稱編號排列
+    void compute_features(uint64_t own, uint64_t opp, uint32_t* features) const {
+#if EVAL_HAVE_AVX2
+        if (vectorized) {
+            eval_features_avx2(ternary, offsets, own, opp, features);
+            return;
+        }
+#endif
+        for (int s = 0; s < SYMMETRY_COUNT; s++) {
+            uint64_t o = transform_board(own, s);
+            uint64_t x = transform_board(opp, s);
+            for (int p = 0; p < EVAL_PATTERN_COUNT; p++) {
+                features[p * SYMMETRY_COUNT + s] = offsets[p] + ternary[pattern_bits(o, EVAL_PATTERNS[p])] +
+                                                   2 * ternary[pattern_bits(x, EVAL_PATTERNS[p])];
+            }
+        }
+    }
+
+    // 以 own（輪到的一方）的角度評估
+    int evaluate(uint64_t own, uint64_t opp) const {
+        uint32_t features[EVAL_FEATURE_COUNT];
+        compute_features(own, opp, features);
+
+        int empties = 64 - __builtin_popcountll(own | opp);
+        const int16_t* w = &weights[eval_phase(empties) * EVAL_PHASE_SIZE];
+        int score = 0;
+        for (int i = 0; i < EVAL_FEATURE_COUNT; i++) score += w[features[i]];
+
+        int mobility = __builtin_popcountll(Game::generate_moves(own, opp)) -
+                       __builtin_popcountll(Game::generate_moves(opp, own));
+        score += w[EVAL_MOBILITY] * mobility;
+        if (empties & 1) score += w[EVAL_PARITY];
+        return score / EVAL_SCALE;
+    }
+};
+
+#endif // EVAL_HPP
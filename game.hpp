@@ -4,231 +4,406 @@
 #include <iostream>
 #include <vector>
 #include <string>
-#include <sstream>
+#include <stdint.h>
+
+#define ZOBRIST_SQUARES 128   // 最大的棋盤（10x10）也放得下
+
+// Zobrist 雜湊用的亂數表；固定種子，讓不同程式算出的 hash 一致（可寫進檔案）。
+// 前 64 格與 side 的產生順序和只有 8x8 時相同，8x8 的 hash（開局庫、對局紀錄）不受影響
+struct ZobristKeys {
+    uint64_t black[ZOBRIST_SQUARES];
+    uint64_t white[ZOBRIST_SQUARES];
+    uint64_t flip[ZOBRIST_SQUARES];   // black ^ white：翻轉一顆棋子只需一次 XOR
+    uint64_t side;                    // 輪到 O 時加入
+
+    ZobristKeys() {
+        uint64_t state = 0x5265766572736921ULL;
+        for (int sq = 0; sq < 64; sq++) {
+            generate(state, sq);
+        }
+        side = next(state);
+        for (int sq = 64; sq < ZOBRIST_SQUARES; sq++) {
+            generate(state, sq);
+        }
+    }
+
+    void generate(uint64_t& state, int sq) {
+        black[sq] = next(state);
+        white[sq] = next(state);
+        flip[sq] = black[sq] ^ white[sq];
+    }
+
+    // splitmix64
+    static uint64_t next(uint64_t& state) {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    static const ZobristKeys& get() {
+        static const ZobristKeys keys;
+        return keys;
+    }
+};
+
+// 每種大小的 bitboard 型別：N*N 格放得進 64 bits 就用 uint64_t，10x10 改用 128 bits
+template<int N, bool FITS_64 = (N * N <= 64)>
+struct BoardBits {
+    typedef uint64_t type;
+};
+
+template<int N>
+struct BoardBits<N, false> {
+    __extension__ typedef unsigned __int128 type;
+};
+
+static inline int bit_count(uint64_t b) { return __builtin_popcountll(b); }
+static inline int lowest_bit(uint64_t b) { return __builtin_ctzll(b); }
+
+__extension__ static inline int bit_count(unsigned __int128 b) {
+    return __builtin_popcountll((uint64_t)b) + __builtin_popcountll((uint64_t)(b >> 64));
+}
+
+__extension__ static inline int lowest_bit(unsigned __int128 b) {
+    uint64_t low = (uint64_t)b;
+    return low ? __builtin_ctzll(low) : 64 + __builtin_ctzll((uint64_t)(b >> 64));
+}
+
+// 編譯期算出的遮罩：棋盤上所有格子，以及某一行（col）從第 row 列到最後一列的格子
+template<typename Bitboard>
+constexpr Bitboard board_mask(int n) {
+    return n * n == (int)sizeof(Bitboard) * 8 ? ~(Bitboard)0 : (((Bitboard)1 << (n * n)) - 1);
+}
+
+template<typename Bitboard>
+constexpr Bitboard column_mask(int n, int col, int row) {
+    return row >= n ? (Bitboard)0 : (((Bitboard)1 << (row * n + col)) | column_mask<Bitboard>(n, col, row + 1));
+}
+
+// N x N 的棋盤以兩個 bitboard 表示：第 row*N+col 個 bit 代表 (row, col)
+// row 0 是第 N 列（畫面最上方），col 0 是 a 行。
+// 方向位移與邊界遮罩都是依 N 在編譯期算好的常數，內層迴圈沒有執行期的大小判斷；
+// 8x8 以外的大小目前只有 perft 使用，伺服器與其他工具都用 Game（8x8）
+template<int N>
+class BasicGame {
+    static_assert(N >= 4 && N <= 10 && N % 2 == 0, "board size must be even, from 4 to 10");
+
+public:
+    typedef typename BoardBits<N>::type Bitboard;
+    static const int SIZE = N;
+    static const int SQUARES = N * N;
 
-class Game {
 private:
-    char board[8][8];
+    Bitboard black;   // X 的棋子
+    Bitboard white;   // O 的棋子
     char current_player;
     int black_count;
     int white_count;
-    
-    // 八個方向：上、下、左、右、左上、右上、左下、右下
-    const int dx[8] = {-1, 1, 0, 0, -1, -1, 1, 1};
-    const int dy[8] = {0, 0, -1, 1, -1, 1, -1, 1};
-    
-    bool is_valid_pos(int row, int col) {
-        return row >= 0 && row < 8 && col >= 0 && col < 8;
-    }
-    
-    // 檢查某個方向是否可以翻轉棋子
-    bool check_direction(int row, int col, int dir, char player) {
-        char opponent = (player == 'X') ? 'O' : 'X';
-        int r = row + dx[dir];
-        int c = col + dy[dir];
-        
-        // 至少要有一個對手的棋子
-        if (!is_valid_pos(r, c) || board[r][c] != opponent) {
-            return false;
-        }
-        
-        // 繼續往這個方向找
-        r += dx[dir];
-        c += dy[dir];
-        
-        while (is_valid_pos(r, c)) {
-            if (board[r][c] == '*') {
-                return false;  // 遇到空格
-            }
-            if (board[r][c] == player) {
-                return true;  // 找到自己的棋子
-            }
-            r += dx[dir];
-            c += dy[dir];
-        }
-        
-        return false;
-    }
-    
-    // 翻轉某個方向的棋子
-    void flip_direction(int row, int col, int dir, char player) {
-        char opponent = (player == 'X') ? 'O' : 'X';
-        int r = row + dx[dir];
-        int c = col + dy[dir];
-        
-        while (is_valid_pos(r, c) && board[r][c] == opponent) {
-            board[r][c] = player;
-            r += dx[dir];
-            c += dy[dir];
-        }
-    }
-    
+    uint64_t hash;    // Zobrist hash（棋子 + 輪到誰），make_move 時增量更新
+
+    static constexpr Bitboard FULL_MASK = board_mask<Bitboard>(N);
+    // 去掉最左、最右兩行，避免水平、斜向位移時跨列繞回
+    static constexpr Bitboard INNER_MASK =
+        FULL_MASK & ~column_mask<Bitboard>(N, 0, 0) & ~column_mask<Bitboard>(N, N - 1, 0);
+    // 1 水平、N - 1 與 N + 1 斜向、N 垂直
+    static constexpr int SHIFTS[4] = {1, N - 1, N, N + 1};
+
+    static Bitboard square_bit(int sq) { return (Bitboard)1 << sq; }
+
+    // 往正方向（<<）或負方向（>>）位移 s 格；往正方向可能超出棋盤，由呼叫端以遮罩去掉
+    static Bitboard shift(Bitboard b, int s, bool forward) {
+        return forward ? (b << s) : (b >> s);
+    }
+
+    bool is_valid_pos(int row, int col) const {
+        return row >= 0 && row < N && col >= 0 && col < N;
+    }
+
+    Bitboard own_board(char player) const { return player == 'X' ? black : white; }
+    Bitboard opp_board(char player) const { return player == 'X' ? white : black; }
+
+    char cell(int row, int col) const {
+        Bitboard bit = square_bit(row * N + col);
+        if (black & bit) return 'X';
+        if (white & bit) return 'O';
+        return '*';
+    }
+
     void count_pieces() {
-        black_count = 0;
-        white_count = 0;
-        for (int i = 0; i < 8; i++) {
-            for (int j = 0; j < 8; j++) {
-                if (board[i][j] == 'X') black_count++;
-                else if (board[i][j] == 'O') white_count++;
+        black_count = bit_count(black);
+        white_count = bit_count(white);
+    }
+
+    void compute_hash() {
+        const ZobristKeys& keys = ZobristKeys::get();
+        hash = (current_player == 'O') ? keys.side : 0;
+        for (Bitboard b = black; b; b &= b - 1) hash ^= keys.black[lowest_bit(b)];
+        for (Bitboard b = white; b; b &= b - 1) hash ^= keys.white[lowest_bit(b)];
+    }
+
+public:
+    // 以下兩個函式直接作用在 bitboard 上，搜尋與殘局求解不必建立 Game 物件
+    // 計算 player 所有合法位置（每個方向連續展開對手棋子，最後落在空格上）
+    static Bitboard generate_moves(Bitboard own, Bitboard opp) {
+        Bitboard empty = ~(own | opp) & FULL_MASK;
+        Bitboard moves = 0;
+
+        for (int i = 0; i < 4; i++) {
+            int s = SHIFTS[i];
+            Bitboard mask = (s == N) ? opp : (opp & INNER_MASK);
+            for (int f = 0; f < 2; f++) {
+                bool forward = (f == 0);
+                // 一條線上最多夾住 N - 2 顆對手棋子；次數是編譯期常數，完全展開成和手寫相同的指令
+                Bitboard x = shift(own, s, forward) & mask;
+#pragma GCC unroll 8
+                for (int k = 0; k < N - 3; k++) {
+                    x |= shift(x, s, forward) & mask;
+                }
+                moves |= shift(x, s, forward) & empty;
             }
         }
+        return moves;
     }
 
-public:
-    Game() {
-        // 初始化棋盤
-        for (int i = 0; i < 8; i++) {
-            for (int j = 0; j < 8; j++) {
-                board[i][j] = '*';
+    // 計算在 sq 下棋後會被翻轉的對手棋子
+    static Bitboard compute_flips(int sq, Bitboard own, Bitboard opp) {
+        Bitboard m = square_bit(sq);
+        Bitboard flips = 0;
+
+        for (int i = 0; i < 4; i++) {
+            int s = SHIFTS[i];
+            Bitboard mask = (s == N) ? opp : (opp & INNER_MASK);
+            for (int f = 0; f < 2; f++) {
+                bool forward = (f == 0);
+                Bitboard line = 0;
+                Bitboard x = shift(m, s, forward);
+                while (x & mask) {
+                    line |= x;
+                    x = shift(x, s, forward);
+                }
+                // 必須以自己的棋子收尾才算夾住
+                if (x & own) {
+                    flips |= line;
+                }
             }
         }
-        
-        // 設置初始四顆棋子（從上到下是第8列到第1列）
-        board[3][3] = 'X';  // d5
-        board[3][4] = 'O';  // e5
-        board[4][3] = 'O';  // d4
-        board[4][4] = 'X';  // e4
-        
+        return flips;
+    }
+
+    BasicGame() {
+        // 設置中央的初始四顆棋子（從上到下是第 N 列到第 1 列；8x8 為 d5、e4 黑，e5、d4 白）
+        const int c = N / 2 - 1;
+        black = square_bit(c * N + c) | square_bit((c + 1) * N + c + 1);
+        white = square_bit(c * N + c + 1) | square_bit((c + 1) * N + c);
+
         current_player = 'X';  // X 先手
         black_count = 2;
         white_count = 2;
+        compute_hash();
     }
-    
+
     // 檢查某個位置是否可以下棋
-    bool is_valid_move(int row, int col, char player) {
-        if (!is_valid_pos(row, col) || board[row][col] != '*') {
+    bool is_valid_move(int row, int col, char player) const {
+        if (!is_valid_pos(row, col)) {
             return false;
         }
-        
-        // 檢查八個方向是否至少有一個可以翻轉
-        for (int dir = 0; dir < 8; dir++) {
-            if (check_direction(row, col, dir, player)) {
-                return true;
-            }
+        int sq = row * N + col;
+        if ((black | white) & square_bit(sq)) {
+            return false;
         }
-        
-        return false;
+        return compute_flips(sq, own_board(player), opp_board(player)) != 0;
     }
-    
+
     // 下棋
     bool make_move(int row, int col, char player) {
-        if (!is_valid_move(row, col, player)) {
+        if (!is_valid_pos(row, col)) {
             return false;
         }
-        
-        board[row][col] = player;
-        
-        // 翻轉所有可以翻轉的方向
-        for (int dir = 0; dir < 8; dir++) {
-            if (check_direction(row, col, dir, player)) {
-                flip_direction(row, col, dir, player);
-            }
+        int sq = row * N + col;
+        Bitboard bit = square_bit(sq);
+        if ((black | white) & bit) {
+            return false;
+        }
+
+        Bitboard flips = compute_flips(sq, own_board(player), opp_board(player));
+        if (flips == 0) {
+            return false;
+        }
+
+        const ZobristKeys& keys = ZobristKeys::get();
+        if (player == 'X') {
+            black |= bit | flips;
+            white &= ~flips;
+            hash ^= keys.black[sq];
+        } else {
+            white |= bit | flips;
+            black &= ~flips;
+            hash ^= keys.white[sq];
         }
-        
+        for (Bitboard b = flips; b; b &= b - 1) {
+            hash ^= keys.flip[lowest_bit(b)];
+        }
+
         count_pieces();
-        current_player = (player == 'X') ? 'O' : 'X';
+        set_current_player((player == 'X') ? 'O' : 'X');
         return true;
     }
-    
+
     // 將字串座標轉換為行列（例如 "a1" -> row=7, col=0）
-    bool parse_move(const std::string& move, int& row, int& col) {
-        if (move.length() != 2) return false;
-        
+    bool parse_move(const std::string& move, int& row, int& col) const {
+        return parse_move(move.data(), move.length(), row, col);
+    }
+
+    // 列號超過 9 時為兩位數（例如 10x10 的 "a10"）；不接受開頭的 0（"a01"），每格只有一種寫法
+    bool parse_move(const char* move, size_t length, int& row, int& col) const {
+        if (length < 2 || length > (N >= 10 ? 3 : 2)) return false;
+        if (move[1] == '0') return false;
+
+        int number = 0;
+        for (size_t i = 1; i < length; i++) {
+            if (move[i] < '0' || move[i] > '9') return false;
+            number = number * 10 + (move[i] - '0');
+        }
         col = move[0] - 'a';
-        row = 8 - (move[1] - '0');  // '1' 對應 row 7，'8' 對應 row 0
-        
+        row = N - number;  // '1' 對應 row N - 1，'N' 對應 row 0
+
         return is_valid_pos(row, col);
     }
-    
+
+    // 將行列轉換為字串座標（例如 row=7, col=0 -> "a1"）
+    std::string format_move(int row, int col) const {
+        std::string move(1, 'a' + col);
+        int number = N - row;
+        if (number >= 10) move += '0' + number / 10;
+        move += '0' + number % 10;
+        return move;
+    }
+
+    // 某個玩家所有合法位置的 bitmask
+    Bitboard get_valid_moves(char player) const {
+        return generate_moves(own_board(player), opp_board(player));
+    }
+
     // 檢查某個玩家是否有合法的移動
-    bool has_valid_moves(char player) {
-        for (int i = 0; i < 8; i++) {
-            for (int j = 0; j < 8; j++) {
-                if (is_valid_move(i, j, player)) {
-                    return true;
-                }
-            }
-        }
-        return false;
+    bool has_valid_moves(char player) const {
+        return get_valid_moves(player) != 0;
     }
-    
+
     // 檢查遊戲是否結束
-    bool is_game_over() {
+    bool is_game_over() const {
         return !has_valid_moves('X') && !has_valid_moves('O');
     }
-    
-    // 顯示棋盤
-    void print_board(const std::string& player_name, const std::string& opponent_name, 
-                     char your_piece, bool is_your_turn) {
+
+    // 顯示棋盤；輪到自己時以 get_valid_moves 計算提示位置
+    void print_board(const std::string& player_name, const std::string& opponent_name,
+                     char your_piece, bool is_your_turn) const {
+        print_board(player_name, opponent_name, your_piece, is_your_turn,
+                    is_your_turn ? get_valid_moves(your_piece) : 0);
+    }
+
+    // 顯示棋盤；hints 為要標示 + 的位置（例如 server 送來的合法位置 mask）
+    void print_board(const std::string& player_name, const std::string& opponent_name,
+                     char your_piece, bool is_your_turn, Bitboard hints) const {
         // ANSI 顏色代碼
         const std::string RED = "\033[31m";
         const std::string GREEN = "\033[32m";
         const std::string YELLOW = "\033[33m";
         const std::string RESET = "\033[0m";
-        
-        std::cout << "\n" << player_name << "(you): " << your_piece << "    " 
+
+        std::cout << "\n" << player_name << "(you): " << your_piece << "    "
                   << opponent_name << ": " << (your_piece == 'X' ? 'O' : 'X') << "\n";
-        
+
         // 顯示棋子數量
         std::cout << "X: " << black_count << "    O: " << white_count << "\n";
-        
+
         if (is_your_turn) {
             std::cout << "now it's your turn.\n";
         } else {
             std::cout << "The opponent is thinking.\n";
         }
-        
-        for (int i = 0; i < 8; i++) {
-            std::cout << (8 - i) << " ";
-            for (int j = 0; j < 8; j++) {
-                if (board[i][j] == 'X') {
+
+        // 列號超過 9 時靠右對齊成兩位數
+        const int label_width = (N >= 10) ? 2 : 1;
+        for (int i = 0; i < N; i++) {
+            if (label_width == 2 && N - i < 10) std::cout << " ";
+            std::cout << (N - i) << " ";
+            for (int j = 0; j < N; j++) {
+                char c = cell(i, j);
+                if (c == 'X') {
                     std::cout << RED << "X" << RESET << " ";
-                } else if (board[i][j] == 'O') {
+                } else if (c == 'O') {
                     std::cout << GREEN << "O" << RESET << " ";
-                } else if (is_your_turn && is_valid_move(i, j, your_piece)) {
+                } else if (hints & square_bit(i * N + j)) {
                     // 顯示可下的位置
                     std::cout << YELLOW << "+" << RESET << " ";
                 } else {
-                    std::cout << board[i][j] << " ";
+                    std::cout << c << " ";
                 }
             }
             std::cout << "\n";
         }
-        std::cout << "  a b c d e f g h\n";
+        std::cout << std::string(label_width + 1, ' ');
+        for (int j = 0; j < N; j++) {
+            std::cout << (char)('a' + j) << (j + 1 < N ? " " : "\n");
+        }
     }
-    
+
     // 獲取棋盤狀態（用於網路傳輸）
-    std::string get_board_state() {
-        std::stringstream ss;
-        for (int i = 0; i < 8; i++) {
-            for (int j = 0; j < 8; j++) {
-                ss << board[i][j];
-            }
+    std::string get_board_state() const {
+        std::string state(SQUARES, '*');
+        write_board_state(&state[0]);
+        return state;
+    }
+
+    // 同 get_board_state，直接寫進呼叫端的 N*N bytes，不配置記憶體
+    void write_board_state(char* out) const {
+        for (int sq = 0; sq < SQUARES; sq++) {
+            Bitboard bit = square_bit(sq);
+            if (black & bit) out[sq] = 'X';
+            else if (white & bit) out[sq] = 'O';
+            else out[sq] = '*';
         }
-        return ss.str();
     }
-    
+
     // 設置棋盤狀態（用於網路傳輸）
     void set_board_state(const std::string& state) {
-        if (state.length() != 64) return;
-        
-        int idx = 0;
-        for (int i = 0; i < 8; i++) {
-            for (int j = 0; j < 8; j++) {
-                board[i][j] = state[idx++];
-            }
+        if (state.length() != (size_t)SQUARES) return;
+
+        black = 0;
+        white = 0;
+        for (int sq = 0; sq < SQUARES; sq++) {
+            if (state[sq] == 'X') black |= square_bit(sq);
+            else if (state[sq] == 'O') white |= square_bit(sq);
         }
         count_pieces();
+        compute_hash();
     }
-    
-    char get_current_player() { return current_player; }
-    void set_current_player(char player) { current_player = player; }
-    int get_black_count() { return black_count; }
-    int get_white_count() { return white_count; }
-    
-    // 獲取遊戲結果
-    std::string get_result() {
+
+    // 直接以 bitboard 設置棋盤（用於二進位協定）
+    void set_bitboards(Bitboard black_board, Bitboard white_board) {
+        black = black_board;
+        white = white_board;
         count_pieces();
+        compute_hash();
+    }
+
+    Bitboard get_black_board() const { return black; }
+    Bitboard get_white_board() const { return white; }
+
+    char get_current_player() const { return current_player; }
+    void set_current_player(char player) {
+        if (player != current_player) {
+            hash ^= ZobristKeys::get().side;
+            current_player = player;
+        }
+    }
+    uint64_t get_hash() const { return hash; }
+    int get_black_count() const { return black_count; }
+    int get_white_count() const { return white_count; }
+
+    // 獲取遊戲結果
+    std::string get_result() const {
         if (black_count > white_count) {
             return "X wins!";
         } else if (white_count > black_count) {
@@ -239,4 +414,11 @@ public:
     }
 };
 
-#endif // GAME_HPP
\ No newline at end of file
+template<int N> constexpr typename BasicGame<N>::Bitboard BasicGame<N>::FULL_MASK;
+template<int N> constexpr typename BasicGame<N>::Bitboard BasicGame<N>::INNER_MASK;
+template<int N> constexpr int BasicGame<N>::SHIFTS[4];
+
+// 伺服器、client 與各工具使用的標準 8x8 棋盤
+typedef BasicGame<8> Game;
+
+#endif // GAME_HPP
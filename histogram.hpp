@@ -0,0 +1,90 @@
+#ifndef HISTOGRAM_HPP
+#define HISTOGRAM_HPP
+
+#include <stdint.h>
+#include <cstring>
+
+// log-linear 直方圖（簡化的 HDR histogram）：每個 2 的次方區間再平均切成 16 格，
+// 記錄任何 64-bit 數值都是 O(1)，百分位數的相對誤差小於 1/16；小於 16 的值完全精確
+#define HISTOGRAM_SUB_BITS 4
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_BUCKETS ((64 - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+
+class Histogram {
+private:
+    uint64_t counts[HISTOGRAM_BUCKETS];
+    uint64_t total;
+    uint64_t sum;
+    uint64_t min_value;
+    uint64_t max_value;
+
+    static int bucket_of(uint64_t value) {
+        if (value < HISTOGRAM_SUB_BUCKETS) return (int)value;
+        int msb = 63 - __builtin_clzll(value);
+        int shift = msb - HISTOGRAM_SUB_BITS;
+        return (shift + 1) * HISTOGRAM_SUB_BUCKETS + (int)((value >> shift) & (HISTOGRAM_SUB_BUCKETS - 1));
+    }
+
+    // 這一格涵蓋的最大值
+    static uint64_t bucket_upper(int index) {
+        if (index < HISTOGRAM_SUB_BUCKETS) return (uint64_t)index;
+        int shift = index / HISTOGRAM_SUB_BUCKETS - 1;
+        uint64_t sub = (uint64_t)(index % HISTOGRAM_SUB_BUCKETS);
+        return ((HISTOGRAM_SUB_BUCKETS + sub + 1) << shift) - 1;
+    }
+
+public:
+    Histogram() { reset(); }
+
+    void reset() {
+        memset(counts, 0, sizeof(counts));
+        total = 0;
+        sum = 0;
+        min_value = UINT64_MAX;
+        max_value = 0;
+    }
+
+    void record(uint64_t value) {
+        counts[bucket_of(value)]++;
+        total++;
+        sum += value;
+        if (value < min_value) min_value = value;
+        if (value > max_value) max_value = value;
+    }
+
+    // 合併其他執行緒各自記錄的直方圖
+    void merge(const Histogram& other) {
+        for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+            counts[i] += other.counts[i];
+        }
+        total += other.total;
+        sum += other.sum;
+        if (other.min_value < min_value) min_value = other.min_value;
+        if (other.max_value > max_value) max_value = other.max_value;
+    }
+
+    // percentile 介於 0 到 100，例如 99.9
+    uint64_t percentile(double percentile) const {
+        if (total == 0) return 0;
+        uint64_t rank = (uint64_t)(percentile / 100.0 * total + 0.5);
+        if (rank < 1) rank = 1;
+        if (rank > total) rank = total;
+
+        uint64_t seen = 0;
+        for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+            seen += counts[i];
+            if (seen >= rank) {
+                uint64_t upper = bucket_upper(i);
+                return upper < max_value ? upper : max_value;
+            }
+        }
+        return max_value;
+    }
+
+    uint64_t count() const { return total; }
+    uint64_t min() const { return total ? min_value : 0; }
+    uint64_t max() const { return max_value; }
+    double mean() const { return total ? (double)sum / total : 0.0; }
+};
+
+#endif // HISTOGRAM_HPP
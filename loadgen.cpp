@@ -0,0 +1,452 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+#include <chrono>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <ctime>
+#include "game.hpp"
+#include "protocol.hpp"
+#include "histogram.hpp"
+
+#define LOADGEN_MAX_EVENTS 1024
+
+// 壓力測試設定（由命令列參數決定）
+struct LoadConfig {
+    std::string ip;
+    int port;
+    int connections;       // 同時維持的連線數
+    int duration;          // 測試秒數
+    int connect_rate;      // 每秒最多發起幾個新連線，0 表示不限制
+    bool practice;         // 和電腦對戰，不需要成對
+};
+
+// 一個機器人連線：用本地的 Game 重播 server 送來的每一步，從中挑合法位置下棋
+struct Bot {
+    int fd;
+    int id;
+    bool connected;
+    FrameDecoder decoder;
+    Game game;
+    char piece;
+    bool my_turn;             // 輪到自己，還沒收到 MOVE_OK
+    bool move_in_flight;      // 已送出 MOVE，等待 MOVE_OK
+    bool resync_pending;
+    std::chrono::steady_clock::time_point connect_start;
+    std::chrono::steady_clock::time_point move_sent;
+};
+
+class LoadGenerator {
+private:
+    LoadConfig config;
+    int epoll_fd;
+    unsigned int rand_seed;
+    int next_bot_id;
+    std::vector<Bot*> bots;               // 以 fd 為索引
+    int open_count;
+
+    std::chrono::steady_clock::time_point start_time;
+    Histogram connect_latency;            // 微秒
+    Histogram turn_latency;               // MOVE 到 MOVE_OK，微秒
+    uint64_t connects;
+    uint64_t connect_failures;
+    uint64_t moves;
+    uint64_t games;
+    uint64_t invalid_moves;
+    uint64_t resyncs;
+    uint64_t disconnects;
+    double all_connected_at;              // 第一次到達目標連線數的時間，-1 表示還沒
+
+    static uint64_t micros_since(std::chrono::steady_clock::time_point t) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t).count();
+    }
+
+    double elapsed() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    }
+
+    void send_frame(Bot* b, uint8_t opcode, const void* payload, size_t length) {
+        uint8_t frame[MAX_FRAME_SIZE];
+        size_t n = encode_frame(frame, opcode, payload, length);
+        send(b->fd, frame, n, MSG_NOSIGNAL);
+    }
+
+    bool open_bot() {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if (fd < 0) {
+            connect_failures++;
+            return false;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        struct sockaddr_in address;
+        address.sin_family = AF_INET;
+        address.sin_port = htons(config.port);
+        inet_pton(AF_INET, config.ip.c_str(), &address.sin_addr);
+
+        if (connect(fd, (struct sockaddr*)&address, sizeof(address)) < 0 && errno != EINPROGRESS) {
+            close(fd);
+            connect_failures++;
+            return false;
+        }
+
+        if ((size_t)fd >= bots.size()) {
+            bots.resize(fd + 1, NULL);
+        }
+        Bot* b = new Bot();
+        b->fd = fd;
+        b->id = next_bot_id++;
+        b->connected = false;
+        b->piece = ' ';
+        b->my_turn = false;
+        b->move_in_flight = false;
+        b->resync_pending = false;
+        b->connect_start = std::chrono::steady_clock::now();
+        bots[fd] = b;
+        open_count++;
+
+        struct epoll_event ev;
+        ev.events = EPOLLOUT;
+        ev.data.fd = fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+        return true;
+    }
+
+    void close_bot(Bot* b) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, b->fd, NULL);
+        close(b->fd);
+        bots[b->fd] = NULL;
+        open_count--;
+        delete b;
+    }
+
+    void on_connected(Bot* b) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (getsockopt(b->fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err != 0) {
+            connect_failures++;
+            close_bot(b);
+            return;
+        }
+
+        b->connected = true;
+        connects++;
+        connect_latency.record(micros_since(b->connect_start));
+        if (open_count == config.connections && all_connected_at < 0) {
+            all_connected_at = elapsed();
+        }
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.fd = b->fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, b->fd, &ev);
+
+        uint8_t preamble[PREAMBLE_SIZE];
+        write_preamble(preamble);
+        send(b->fd, preamble, sizeof(preamble), MSG_NOSIGNAL);
+
+        std::ostringstream name;
+        name << "bot" << b->id;
+        std::string s = name.str();
+        send_frame(b, config.practice ? OP_HELLO_PRACTICE : OP_HELLO, s.data(), s.size());
+    }
+
+    void request_resync(Bot* b) {
+        if (b->resync_pending) return;
+        b->resync_pending = true;
+        resyncs++;
+        send_frame(b, OP_RESYNC, NULL, 0);
+    }
+
+    // 從本地棋盤隨機挑一個合法位置；本地棋盤不對（沒有合法位置）時先重新同步
+    void play_move(Bot* b) {
+        if (!b->my_turn || b->move_in_flight || b->resync_pending) return;
+
+        uint64_t moves = b->game.get_valid_moves(b->piece);
+        if (moves == 0) {
+            request_resync(b);
+            return;
+        }
+        int pick = rand_r(&rand_seed) % __builtin_popcountll(moves);
+        for (int i = 0; i < pick; i++) moves &= moves - 1;
+        uint8_t square = __builtin_ctzll(moves);
+
+        b->move_in_flight = true;
+        b->move_sent = std::chrono::steady_clock::now();
+        send_frame(b, OP_MOVE, &square, 1);
+    }
+
+    // 回傳 false 表示這個機器人的對局已結束，應關閉
+    bool handle_frame(Bot* b, const Frame& f) {
+        switch (f.opcode) {
+            case OP_START:
+                if (f.length >= 1) {
+                    b->piece = f.payload[0];
+                    b->game = Game();
+                }
+                return true;
+
+            case OP_YOUR_TURN:
+                b->my_turn = true;
+                play_move(b);
+                return true;
+
+            case OP_MOVE_OK:
+                if (b->move_in_flight) {
+                    turn_latency.record(micros_since(b->move_sent));
+                    moves++;
+                }
+                b->move_in_flight = false;
+                b->my_turn = false;
+                return true;
+
+            case OP_INVALID:
+                // 本地棋盤和 server 不一致，重新同步後再下一次
+                invalid_moves++;
+                b->move_in_flight = false;
+                request_resync(b);
+                return true;
+
+            case OP_MOVE_PLAYED:
+                if (f.length == MOVE_PLAYED_PAYLOAD_SIZE) {
+                    int square = f.payload[0];
+                    char piece = f.payload[1];
+                    uint64_t flips = get_u64(f.payload + 2);
+                    uint64_t before = (piece == 'X') ? b->game.get_white_board() : b->game.get_black_board();
+                    bool ok = b->game.make_move(square / 8, square % 8, piece);
+                    uint64_t after = (piece == 'X') ? b->game.get_white_board() : b->game.get_black_board();
+                    if (!ok || (before & ~after) != flips) {
+                        request_resync(b);
+                    }
+                }
+                return true;
+
+            case OP_CHECKSUM:
+                if (f.length == 4 &&
+                    board_checksum(b->game.get_black_board(), b->game.get_white_board()) != get_u32(f.payload)) {
+                    request_resync(b);
+                }
+                return true;
+
+            case OP_BOARD:
+                if (f.length == BOARD_PAYLOAD_SIZE) {
+                    b->game.set_bitboards(get_u64(f.payload), get_u64(f.payload + 8));
+                    b->resync_pending = false;
+                    play_move(b);
+                }
+                return true;
+
+            case OP_PING:
+                send_frame(b, OP_PONG, NULL, 0);
+                return true;
+
+            case OP_END:
+                games++;
+                return false;
+
+            case OP_OPPONENT_DISCONNECT:
+                disconnects++;
+                return false;
+
+            default:
+                return true;
+        }
+    }
+
+    void handle_readable(Bot* b) {
+        while (true) {
+            ssize_t n = read(b->fd, b->decoder.write_ptr(), b->decoder.write_space());
+            if (n > 0) {
+                b->decoder.commit(n);
+                Frame f;
+                while (b->decoder.next(f)) {
+                    if (!handle_frame(b, f)) {
+                        close_bot(b);
+                        return;
+                    }
+                }
+                if (b->decoder.is_malformed()) {
+                    disconnects++;
+                    close_bot(b);
+                    return;
+                }
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                return;
+            }
+            // server 關閉連線或發生錯誤
+            disconnects++;
+            close_bot(b);
+            return;
+        }
+    }
+
+    // 依連線速率限制補足連線數（對局結束的機器人會由新的連線取代）
+    void top_up(double now, int& opened) {
+        while (open_count < config.connections) {
+            if (config.connect_rate > 0 && opened >= (int)(now * config.connect_rate)) {
+                break;
+            }
+            opened++;
+            if (!open_bot()) break;
+        }
+    }
+
+    void print_progress(double now, uint64_t last_moves) {
+        std::cout << std::fixed << std::setprecision(0) << "t=" << now << "s"
+                  << " open=" << open_count << " connected=" << connects
+                  << " games=" << games << " moves/s=" << (moves - last_moves)
+                  << " p99=" << turn_latency.percentile(99) << "us\n" << std::flush;
+    }
+
+    void report(double seconds) {
+        std::cout << "\n--- " << config.connections << " connections, " << std::setprecision(1)
+                  << seconds << " s ---\n";
+        std::cout << "connects:     " << connects << " ok, " << connect_failures << " failed";
+        if (all_connected_at > 0) {
+            std::cout << ", " << std::setprecision(0) << config.connections / all_connected_at
+                      << " connects/s until all " << config.connections << " were up";
+        }
+        std::cout << "\n";
+        std::cout << "connect time: p50 " << connect_latency.percentile(50) << " us, p99 "
+                  << connect_latency.percentile(99) << " us, max " << connect_latency.max() << " us\n";
+        std::cout << "moves:        " << moves << " (" << std::setprecision(0)
+                  << moves / seconds << " moves/s), games finished " << games << "\n";
+        std::cout << "turn RTT:     p50 " << turn_latency.percentile(50) << " us, p99 "
+                  << turn_latency.percentile(99) << " us, p999 " << turn_latency.percentile(99.9)
+                  << " us, max " << turn_latency.max() << " us, mean "
+                  << std::setprecision(1) << turn_latency.mean() << " us\n";
+        std::cout << "errors:       " << invalid_moves << " invalid moves, " << resyncs << " resyncs, "
+                  << disconnects << " unexpected disconnects\n";
+    }
+
+public:
+    LoadGenerator(const LoadConfig& load_config) {
+        config = load_config;
+        epoll_fd = -1;
+        rand_seed = time(NULL);
+        next_bot_id = 0;
+        open_count = 0;
+        connects = 0;
+        connect_failures = 0;
+        moves = 0;
+        games = 0;
+        invalid_moves = 0;
+        resyncs = 0;
+        disconnects = 0;
+        all_connected_at = -1;
+    }
+
+    ~LoadGenerator() {
+        for (size_t i = 0; i < bots.size(); i++) {
+            if (bots[i] != NULL) close_bot(bots[i]);
+        }
+        if (epoll_fd != -1) close(epoll_fd);
+    }
+
+    bool run() {
+        // 每個機器人一個 fd，把上限調到系統允許的最大值
+        struct rlimit rl;
+        if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+            rl.rlim_cur = rl.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &rl);
+        }
+
+        epoll_fd = epoll_create1(0);
+        if (epoll_fd < 0) {
+            std::cerr << "epoll_create1 failed\n";
+            return false;
+        }
+
+        start_time = std::chrono::steady_clock::now();
+        int opened = 0;
+        int next_report = 1;
+        uint64_t last_moves = 0;
+        struct epoll_event events[LOADGEN_MAX_EVENTS];
+
+        while (true) {
+            double now = elapsed();
+            if (now >= config.duration) break;
+            if (now >= next_report) {
+                print_progress(now, last_moves);
+                last_moves = moves;
+                next_report++;
+            }
+
+            top_up(now, opened);
+
+            int n = epoll_wait(epoll_fd, events, LOADGEN_MAX_EVENTS, 10);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                std::cerr << "epoll_wait failed\n";
+                return false;
+            }
+
+            for (int i = 0; i < n; i++) {
+                int fd = events[i].data.fd;
+                Bot* b = ((size_t)fd < bots.size()) ? bots[fd] : NULL;
+                if (b == NULL) continue;
+
+                if (!b->connected) {
+                    on_connected(b);
+                } else {
+                    handle_readable(b);
+                }
+            }
+        }
+
+        report(elapsed());
+        return true;
+    }
+};
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cout << "Usage: " << argv[0] << " <server_ip> <server_port> [-c connections] [-d seconds]"
+                  << " [-r connects_per_second] [--practice]\n";
+        return 1;
+    }
+
+    LoadConfig config;
+    config.ip = argv[1];
+    config.port = atoi(argv[2]);
+    config.connections = 1000;
+    config.duration = 10;
+    config.connect_rate = 0;
+    config.practice = false;
+
+    for (int i = 3; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-c" && i + 1 < argc) {
+            config.connections = atoi(argv[++i]);
+        } else if (arg == "-d" && i + 1 < argc) {
+            config.duration = atoi(argv[++i]);
+        } else if (arg == "-r" && i + 1 < argc) {
+            config.connect_rate = atoi(argv[++i]);
+        } else if (arg == "--practice") {
+            config.practice = true;
+        } else {
+            std::cout << "Unknown option: " << arg << "\n";
+            return 1;
+        }
+    }
+    if (config.connections <= 0) config.connections = 1;
+    if (config.duration <= 0) config.duration = 10;
+    if (config.connect_rate < 0) config.connect_rate = 0;
+
+    LoadGenerator generator(config);
+    return generator.run() ? 0 : 1;
+}
\ No newline at end of file
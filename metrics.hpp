@@ -0,0 +1,162 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <stdint.h>
+#include <string>
+#include <sstream>
+#include <chrono>
+#include "histogram.hpp"
+
+// 伺服器的效能統計：每個 shard 各有一份計數器與延遲直方圖，只由自己的執行緒寫入，
+// 下棋路徑上只有一般的加法與讀時鐘，不用 atomic、不加鎖。
+// 匯出時由各 shard 在事件迴圈的空檔複製一份快照，再合併成 Prometheus 的文字格式。
+// 編譯時加上 -DNO_METRICS（make METRICS=0）整個拿掉，所有記錄函式都是空的，會被編譯器刪除
+#ifdef NO_METRICS
+#define METRICS_ENABLED 0
+#else
+#define METRICS_ENABLED 1
+#endif
+
+// 下棋路徑上各階段的延遲（ns）
+enum LatencyMetric {
+    LATENCY_ACCEPT,      // accept 到 shard 開始監聽這條連線（交接佇列的等待時間）
+    LATENCY_DECODE,      // 從解碼緩衝區切出一個 frame
+    LATENCY_VALIDATE,    // 檢查棋步是否合法
+    LATENCY_MAKE_MOVE,   // Game::make_move
+    LATENCY_ENCODE,      // 編碼這一步要送給雙方與觀眾的 frame
+    LATENCY_SEND,        // 一次 sendmsg
+    LATENCY_METRIC_COUNT
+};
+
+enum CounterMetric {
+    COUNTER_CONNECTIONS,      // 接受的連線數
+    COUNTER_FRAMES_IN,        // 收到的二進位 frame 數
+    COUNTER_BYTES_IN,
+    COUNTER_BYTES_OUT,
+    COUNTER_MOVES,
+    COUNTER_INVALID_MOVES,
+    COUNTER_MATCHES,          // 開始的對局數
+    COUNTER_SPECTATOR_DROPS,  // 觀眾跟不上、丟掉更新改送完整棋盤的次數
+    COUNTER_METRIC_COUNT
+};
+
+// 匯出當下的數值，由 shard 在複製快照時填入
+enum GaugeMetric {
+    GAUGE_CONNECTIONS,        // 目前的連線數（包含電腦玩家）
+    GAUGE_MATCHES,            // 進行中的對局數
+    GAUGE_SPECTATORS,
+    GAUGE_WAITING,            // 配對佇列長度
+    GAUGE_AI_SEARCHES,        // 正在思考的電腦數
+    GAUGE_INBOX,              // 其他執行緒交來、還沒處理的連線與電腦棋步
+    GAUGE_METRIC_COUNT
+};
+
+#if METRICS_ENABLED
+
+static const char* const LATENCY_NAMES[LATENCY_METRIC_COUNT] = {
+    "accept", "decode", "validate", "make_move", "encode", "send"
+};
+
+static const char* const COUNTER_NAMES[COUNTER_METRIC_COUNT] = {
+    "reversi_connections_total", "reversi_frames_received_total", "reversi_received_bytes_total",
+    "reversi_sent_bytes_total", "reversi_moves_total", "reversi_invalid_moves_total",
+    "reversi_matches_total", "reversi_spectator_drops_total"
+};
+
+static const char* const GAUGE_NAMES[GAUGE_METRIC_COUNT] = {
+    "reversi_connections", "reversi_active_matches", "reversi_spectators",
+    "reversi_waiting_players", "reversi_ai_searches", "reversi_inbox_depth"
+};
+
+// 單調時鐘（ns）；只用來計算差值
+static inline uint64_t metrics_now() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class ShardMetrics {
+private:
+    Histogram latency[LATENCY_METRIC_COUNT];
+    uint64_t counters[COUNTER_METRIC_COUNT];
+    int64_t gauges[GAUGE_METRIC_COUNT];
+
+public:
+    ShardMetrics() { reset(); }
+
+    void reset() {
+        for (int i = 0; i < LATENCY_METRIC_COUNT; i++) latency[i].reset();
+        for (int i = 0; i < COUNTER_METRIC_COUNT; i++) counters[i] = 0;
+        for (int i = 0; i < GAUGE_METRIC_COUNT; i++) gauges[i] = 0;
+    }
+
+    // start 為 metrics_now() 的回傳值
+    void record_since(LatencyMetric metric, uint64_t start) {
+        latency[metric].record(metrics_now() - start);
+    }
+
+    void record(LatencyMetric metric, uint64_t nanoseconds) { latency[metric].record(nanoseconds); }
+    void add(CounterMetric metric, uint64_t n) { counters[metric] += n; }
+    void set(GaugeMetric metric, int64_t value) { gauges[metric] = value; }
+
+    void merge(const ShardMetrics& other) {
+        for (int i = 0; i < LATENCY_METRIC_COUNT; i++) latency[i].merge(other.latency[i]);
+        for (int i = 0; i < COUNTER_METRIC_COUNT; i++) counters[i] += other.counters[i];
+        for (int i = 0; i < GAUGE_METRIC_COUNT; i++) gauges[i] += other.gauges[i];
+    }
+
+    const Histogram& get_latency(LatencyMetric metric) const { return latency[metric]; }
+    uint64_t get_counter(CounterMetric metric) const { return counters[metric]; }
+    int64_t get_gauge(GaugeMetric metric) const { return gauges[metric]; }
+};
+
+// Prometheus 文字格式（version 0.0.4）：計數器與目前數值依 shard 分開，延遲合併所有 shard 後以 summary 匯出
+static inline std::string format_prometheus(const ShardMetrics* shards, int shard_count) {
+    static const double QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+    std::ostringstream out;
+
+    for (int m = 0; m < COUNTER_METRIC_COUNT; m++) {
+        out << "# TYPE " << COUNTER_NAMES[m] << " counter\n";
+        for (int s = 0; s < shard_count; s++) {
+            out << COUNTER_NAMES[m] << "{shard=\"" << s << "\"} " << shards[s].get_counter((CounterMetric)m) << "\n";
+        }
+    }
+    for (int m = 0; m < GAUGE_METRIC_COUNT; m++) {
+        out << "# TYPE " << GAUGE_NAMES[m] << " gauge\n";
+        for (int s = 0; s < shard_count; s++) {
+            out << GAUGE_NAMES[m] << "{shard=\"" << s << "\"} " << shards[s].get_gauge((GaugeMetric)m) << "\n";
+        }
+    }
+
+    ShardMetrics total;
+    for (int s = 0; s < shard_count; s++) total.merge(shards[s]);
+    out << "# HELP reversi_stage_latency_seconds Latency of each step on the move path.\n";
+    out << "# TYPE reversi_stage_latency_seconds summary\n";
+    for (int m = 0; m < LATENCY_METRIC_COUNT; m++) {
+        const Histogram& h = total.get_latency((LatencyMetric)m);
+        for (size_t q = 0; q < sizeof(QUANTILES) / sizeof(QUANTILES[0]); q++) {
+            out << "reversi_stage_latency_seconds{stage=\"" << LATENCY_NAMES[m] << "\",quantile=\"" << QUANTILES[q]
+                << "\"} " << h.percentile(QUANTILES[q] * 100) * 1e-9 << "\n";
+        }
+        out << "reversi_stage_latency_seconds_sum{stage=\"" << LATENCY_NAMES[m] << "\"} "
+            << h.mean() * h.count() * 1e-9 << "\n";
+        out << "reversi_stage_latency_seconds_count{stage=\"" << LATENCY_NAMES[m] << "\"} " << h.count() << "\n";
+    }
+    return out.str();
+}
+
+#else
+
+static inline uint64_t metrics_now() { return 0; }
+
+class ShardMetrics {
+public:
+    void reset() {}
+    void record_since(LatencyMetric, uint64_t) {}
+    void record(LatencyMetric, uint64_t) {}
+    void add(CounterMetric, uint64_t) {}
+    void set(GaugeMetric, int64_t) {}
+};
+
+#endif // METRICS_ENABLED
+
+#endif // METRICS_HPP
@@ -0,0 +1,244 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <sstream>
+#include <chrono>
+#include <cstdlib>
+#include <stdint.h>
+#include "game.hpp"
+
+#define PERFT_DEFAULT_DEPTH 9
+#define PERFT_VALIDATE_DEPTH 5   // 以逐格掃描的參考實作交叉比對的深度
+
+// 從初始局面開始的已知葉節點數（pass 算一手，終局即為葉節點）
+static const uint64_t START_COUNTS[] = {
+    1ULL, 4ULL, 12ULL, 56ULL, 244ULL, 1396ULL, 8200ULL, 55092ULL, 390216ULL,
+    3005288ULL, 24571284ULL, 212258800ULL, 1939886636ULL, 18429641748ULL, 184042084512ULL
+};
+#define START_COUNTS_DEPTH 14
+
+// 測試局面：棋盤字串（同 get_board_state()，從 a8 開始逐列）、輪到誰、深度與葉節點數
+struct PerftPosition {
+    const char* board;
+    char player;
+    int depth;
+    uint64_t nodes;
+};
+
+// 由隨機對局取樣（第 20、30、40、50、56 手），葉節點數以下方的參考實作算出；
+// 後兩個局面會碰到 pass 與提早終局
+static const PerftPosition TEST_POSITIONS[] = {
+    {"******O*****XO***X*OXX****XOOX***OOXXO**OOO*XOO****O*O**********", 'X', 6, 6083923ULL},
+    {"****XX*****OXXOO***XOX***OOOOOX**OXXOOO**OX*XOX*XO**X**XXO**X***", 'X', 6, 5651012ULL},
+    {"X*X*O***XXXX***XXOXXX*X*XXOOOOOOXXOXXOO**OOOOXX**O*OOXX**OOO**O*", 'X', 7, 5714268ULL},
+    {"X*OXXXXXXX*OOXXXXXXOOXXXOOXOXOXXOOOOOOOXOOOXX***OOOOOO**OXOOX***", 'X', 7, 20751ULL},
+    {"X**XXXXXXX*OXXXXXOXXOXXXXXXXXXXXXXXOXXXXXXOXOXXXXOOOOOOXO*XOOOOO", 'X', 12, 15ULL}
+};
+
+static char opponent_of(char player) { return player == 'X' ? 'O' : 'X'; }
+
+// 透過 Game 的公開介面（get_valid_moves + make_move）計算，等同伺服器實際使用的路徑
+template<int N>
+static uint64_t perft(const BasicGame<N>& game, char player, int depth) {
+    typedef typename BasicGame<N>::Bitboard Bitboard;
+    if (depth == 0) return 1;
+
+    Bitboard moves = game.get_valid_moves(player);
+    if (moves == 0) {
+        if (!game.has_valid_moves(opponent_of(player))) return 1;
+        return perft(game, opponent_of(player), depth - 1);
+    }
+    if (depth == 1) return bit_count(moves);
+
+    uint64_t nodes = 0;
+    for (Bitboard b = moves; b; b &= b - 1) {
+        int sq = lowest_bit(b);
+        BasicGame<N> child = game;
+        child.make_move(sq / N, sq % N, player);
+        nodes += perft(child, opponent_of(player), depth - 1);
+    }
+    return nodes;
+}
+
+// 參考實作：在 n*n 字元的棋盤上逐格、逐方向掃描，完全不用 bitboard
+namespace naive {
+
+static const int DR[8] = {-1, -1, -1, 0, 0, 1, 1, 1};
+static const int DC[8] = {-1, 0, 1, -1, 1, -1, 0, 1};
+
+static int flips_in_direction(const std::string& board, int n, int row, int col, int d, char player) {
+    char opponent = opponent_of(player);
+    int r = row + DR[d], c = col + DC[d];
+    int count = 0;
+    while (r >= 0 && r < n && c >= 0 && c < n && board[r * n + c] == opponent) {
+        r += DR[d];
+        c += DC[d];
+        count++;
+    }
+    if (count > 0 && r >= 0 && r < n && c >= 0 && c < n && board[r * n + c] == player) {
+        return count;
+    }
+    return 0;
+}
+
+static bool is_legal(const std::string& board, int n, int sq, char player) {
+    if (board[sq] != '*') return false;
+    for (int d = 0; d < 8; d++) {
+        if (flips_in_direction(board, n, sq / n, sq % n, d, player) > 0) return true;
+    }
+    return false;
+}
+
+static bool has_moves(const std::string& board, int n, char player) {
+    for (int sq = 0; sq < n * n; sq++) {
+        if (is_legal(board, n, sq, player)) return true;
+    }
+    return false;
+}
+
+static std::string play(const std::string& board, int n, int sq, char player) {
+    std::string next = board;
+    int row = sq / n, col = sq % n;
+    next[sq] = player;
+    for (int d = 0; d < 8; d++) {
+        int count = flips_in_direction(board, n, row, col, d, player);
+        for (int k = 1; k <= count; k++) {
+            next[(row + DR[d] * k) * n + (col + DC[d] * k)] = player;
+        }
+    }
+    return next;
+}
+
+static uint64_t perft(const std::string& board, int n, char player, int depth) {
+    if (depth == 0) return 1;
+
+    uint64_t nodes = 0;
+    bool moved = false;
+    for (int sq = 0; sq < n * n; sq++) {
+        if (!is_legal(board, n, sq, player)) continue;
+        moved = true;
+        nodes += perft(play(board, n, sq, player), n, opponent_of(player), depth - 1);
+    }
+    if (!moved) {
+        if (!has_moves(board, n, opponent_of(player))) return 1;
+        return perft(board, n, opponent_of(player), depth - 1);
+    }
+    return nodes;
+}
+
+}  // namespace naive
+
+static double elapsed(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// 執行一次 perft 並印出結果；expected 為 0 表示沒有參考值
+template<int N>
+static bool run(const std::string& label, const BasicGame<N>& game, char player, int depth, uint64_t expected) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    uint64_t nodes = perft(game, player, depth);
+    double seconds = elapsed(start);
+
+    bool ok = (expected == 0 || nodes == expected);
+    std::cout << std::setw(10) << label << std::setw(4) << depth << std::setw(16) << nodes
+              << std::setw(10) << std::fixed << std::setprecision(3) << seconds
+              << std::setw(14) << (uint64_t)(seconds > 0 ? nodes / seconds : 0)
+              << "  " << (expected == 0 ? "-" : (ok ? "ok" : "FAIL")) << "\n";
+    if (!ok) {
+        std::cout << "  expected " << expected << "\n";
+    }
+    return ok;
+}
+
+// 與參考實作比對淺層的葉節點數
+template<int N>
+static bool validate(const std::string& label, const BasicGame<N>& game, char player, int depth) {
+    bool ok = true;
+    for (int d = 1; d <= depth; d++) {
+        uint64_t fast = perft(game, player, d);
+        uint64_t slow = naive::perft(game.get_board_state(), N, player, d);
+        if (fast != slow) {
+            std::cout << "  " << label << " depth " << d << ": bitboard " << fast
+                      << ", reference " << slow << "  FAIL\n";
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+static void print_header() {
+    std::cout << std::setw(10) << "position" << std::setw(4) << "d" << std::setw(16) << "nodes"
+              << std::setw(10) << "seconds" << std::setw(14) << "nps" << "\n";
+}
+
+// 6x6、10x10 沒有內建的已知節點數，初始局面的每一層都和參考實作比對
+template<int N>
+static bool run_size(int max_depth) {
+    std::cout << N << "x" << N << " board\n";
+    print_header();
+
+    bool ok = true;
+    BasicGame<N> start;
+    for (int depth = 1; depth <= max_depth; depth++) {
+        ok = run("start", start, 'X', depth, 0) && ok;
+    }
+    std::cout << "validating against the reference generator to depth " << PERFT_VALIDATE_DEPTH << "\n";
+    ok = validate("start", start, 'X', PERFT_VALIDATE_DEPTH) && ok;
+
+    std::cout << (ok ? "all counts match\n" : "MISMATCH\n");
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+    int max_depth = PERFT_DEFAULT_DEPTH;
+    int size = 8;
+    bool usage = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--size" && i + 1 < argc) {
+            size = atoi(argv[++i]);
+            if (size != 6 && size != 8 && size != 10) usage = true;
+        } else {
+            max_depth = atoi(argv[i]);
+            if (max_depth <= 0) usage = true;
+        }
+    }
+    if (usage) {
+        std::cout << "Usage: " << argv[0] << " [--size 6|8|10] [depth]\n";
+        return 1;
+    }
+    if (size == 6) return run_size<6>(max_depth) ? 0 : 1;
+    if (size == 10) return run_size<10>(max_depth) ? 0 : 1;
+
+    bool ok = true;
+    print_header();
+
+    Game start;
+    for (int depth = 1; depth <= max_depth; depth++) {
+        uint64_t expected = depth <= START_COUNTS_DEPTH ? START_COUNTS[depth] : 0;
+        ok = run("start", start, 'X', depth, expected) && ok;
+    }
+
+    int count = sizeof(TEST_POSITIONS) / sizeof(TEST_POSITIONS[0]);
+    for (int i = 0; i < count; i++) {
+        const PerftPosition& p = TEST_POSITIONS[i];
+        Game game;
+        game.set_board_state(p.board);
+        std::stringstream label;
+        label << "test " << i;
+        ok = run(label.str(), game, p.player, p.depth, p.nodes) && ok;
+    }
+
+    std::cout << "validating against the reference generator to depth " << PERFT_VALIDATE_DEPTH << "\n";
+    ok = validate("start", start, 'X', PERFT_VALIDATE_DEPTH) && ok;
+    for (int i = 0; i < count; i++) {
+        Game game;
+        game.set_board_state(TEST_POSITIONS[i].board);
+        std::stringstream label;
+        label << "test " << i;
+        ok = validate(label.str(), game, TEST_POSITIONS[i].player, PERFT_VALIDATE_DEPTH) && ok;
+    }
+
+    std::cout << (ok ? "all counts match\n" : "MISMATCH\n");
+    return ok ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+#ifndef POOL_HPP
+#define POOL_HPP
+
+#include <stddef.h>
+#include <vector>
+
+#define POOL_CHUNK_SIZE 64
+
+// 物件池：一次配置一整塊（POOL_CHUNK_SIZE 個物件），釋放的物件放回 free list 重複使用，
+// 記憶體要到整個池解構時才還給系統。物件只在配置整塊時建構一次，
+// 取出後由呼叫端自行重設欄位；已放回的物件仍可安全讀取（例如比對 id 判斷是否已結束）。
+// 不加鎖，只能由單一執行緒使用（每個 shard 各有一組）
+template<typename T>
+class ObjectPool {
+private:
+    std::vector<T*> chunks;
+    std::vector<T*> free_list;
+    size_t in_use;
+
+    void grow() {
+        T* chunk = new T[POOL_CHUNK_SIZE];
+        chunks.push_back(chunk);
+        // 先預留好容量，之後 release 時的 push_back 不會再配置記憶體
+        free_list.reserve(chunks.size() * POOL_CHUNK_SIZE);
+        for (int i = POOL_CHUNK_SIZE - 1; i >= 0; i--) {
+            free_list.push_back(chunk + i);
+        }
+    }
+
+public:
+    ObjectPool() : in_use(0) {}
+
+    ~ObjectPool() {
+        for (size_t i = 0; i < chunks.size(); i++) {
+            delete[] chunks[i];
+        }
+    }
+
+    T* acquire() {
+        if (free_list.empty()) grow();
+        T* object = free_list.back();
+        free_list.pop_back();
+        in_use++;
+        return object;
+    }
+
+    void release(T* object) {
+        free_list.push_back(object);
+        in_use--;
+    }
+
+    size_t used() const { return in_use; }
+    size_t capacity() const { return chunks.size() * POOL_CHUNK_SIZE; }
+
+private:
+    ObjectPool(const ObjectPool&);
+    ObjectPool& operator=(const ObjectPool&);
+};
+
+#endif // POOL_HPP
@@ -0,0 +1,300 @@
+#ifndef PROTOCOL_HPP
+#define PROTOCOL_HPP
+
+#include <stdint.h>
+#include <cstring>
+#include <string>
+#include <sys/uio.h>
+
+// 二進位協定
+//   連線後 client 先送 4 bytes 的 preamble：{0x00, 'R', 'V', 版本}
+//   之後每個 frame 為 [長度 2 bytes, big-endian][opcode 1 byte][payload]
+//   長度欄位包含 opcode，不包含長度欄位本身
+//   棋盤以兩個 64-bit mask 傳送（先黑後白，big-endian），共 16 bytes
+//   每一步只送 MOVE_PLAYED（位置 + 翻轉 mask），client 在本地的 Game 上重播；
+//   每 CHECKSUM_INTERVAL 步送一次 CHECKSUM，不一致時 client 送 RESYNC 取得完整棋盤
+//   server 一段時間沒收到 client 的資料就送 PING，client 回 PONG；仍然沒有回應就斷線
+//   觀戰：preamble 之後送 WATCH 取代 HELLO，收到 WATCH_START（含目前棋盤）後，
+//   和玩家一樣收到 MOVE_PLAYED、CHECKSUM，對局結束時收到 END；跟不上時中間的更新會被丟掉，改送一次 BOARD
+//   續局：server 開啟快照時，START 之後送 RESUME_TOKEN；server 重新啟動後，client 在 preamble 之後
+//   送 RESUME（內容同 token）取代 HELLO，回到原本的座位，依序收到 START、BOARD 與目前的回合事件
+// 舊版 client 直接送名字（文字協定），名字不會以 0x00 開頭，server 依第一個 byte 判斷
+
+#define PROTOCOL_VERSION 2
+#define PREAMBLE_SIZE 4
+#define FRAME_HEADER_SIZE 3
+#define MAX_PAYLOAD_SIZE 255
+#define MAX_FRAME_SIZE (FRAME_HEADER_SIZE + MAX_PAYLOAD_SIZE)
+#define BOARD_PAYLOAD_SIZE 16
+#define MOVE_PLAYED_PAYLOAD_SIZE 10
+#define LEGAL_MASK_PAYLOAD_SIZE 8
+#define CHECKSUM_INTERVAL 8
+#define RESUME_TOKEN_SIZE 12
+#define MAX_NAME_LENGTH 32
+#define DECODER_BUFFER_SIZE 1024
+#define OUTPUT_BUFFER_SIZE 4096       // 2 的次方
+#define OUTPUT_HIGH_WATERMARK 3072    // 待送出超過此值就暫停讀取這條連線
+#define OUTPUT_LOW_WATERMARK 1024     // 降到此值以下再恢復讀取
+
+enum Opcode {
+    // client -> server
+    OP_HELLO = 0x01,                // 名字
+    OP_MOVE = 0x02,                 // 1 byte 位置（row * 8 + col）
+    OP_RESYNC = 0x03,               // 要求完整棋盤
+    OP_HELLO_PRACTICE = 0x04,       // 名字；不排隊配對，直接和電腦對戰
+    OP_PONG = 0x05,                 // 回應 PING
+    OP_WATCH = 0x06,                // 4 bytes 對局編號（0 表示最新開始、仍在進行的對局）
+    OP_RESUME = 0x07,               // RESUME_TOKEN 收到的 12 bytes
+
+    // server -> client
+    OP_WAIT = 0x10,
+    OP_START = 0x11,                // 1 byte 棋子 + 對手名字
+    OP_YOUR_TURN = 0x12,            // 8 bytes 本回合合法位置的 mask
+    OP_OPPONENT_TURN = 0x13,
+    OP_MOVE_OK = 0x14,              // 1 byte 位置
+    OP_INVALID = 0x15,              // 1 byte 原因
+    OP_SKIP = 0x16,
+    OP_OPPONENT_SKIP = 0x17,
+    OP_END = 0x18,                  // 1 byte 結果 + 棋盤
+    OP_OPPONENT_DISCONNECT = 0x19,
+    OP_MOVE_PLAYED = 0x1a,          // 1 byte 位置 + 1 byte 棋子 + 8 bytes 翻轉 mask
+    OP_CHECKSUM = 0x1b,             // 4 bytes 棋盤 checksum
+    OP_BOARD = 0x1c,                // 完整棋盤（回應 RESYNC）
+    OP_PING = 0x1d,                 // 心跳，client 需回 PONG
+    OP_WATCH_START = 0x1e,          // 4 bytes 對局編號 + 棋盤 + X 名字長度 1 byte + 名字 + O 名字長度 1 byte + 名字
+    OP_WATCH_FAILED = 0x1f,         // 找不到對局（已結束或編號錯誤），之後 server 關閉連線
+    OP_RESUME_TOKEN = 0x20,         // 4 bytes 對局編號 + 8 bytes 座位的秘密值
+    OP_RESUME_FAILED = 0x21         // 對局已結束、token 錯誤或座位已有人，之後 server 關閉連線
+};
+
+enum InvalidReason {
+    INVALID_FORMAT = 1,
+    INVALID_MOVE = 2
+};
+
+enum GameResult {
+    RESULT_DRAW = 0,
+    RESULT_X_WINS = 1,
+    RESULT_O_WINS = 2
+};
+
+struct Frame {
+    uint8_t opcode;
+    const uint8_t* payload;
+    size_t length;
+};
+
+static inline void put_u64(uint8_t* p, uint64_t v) {
+    for (int i = 7; i >= 0; i--) {
+        p[i] = (uint8_t)(v & 0xff);
+        v >>= 8;
+    }
+}
+
+static inline uint64_t get_u64(const uint8_t* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+static inline void put_u32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static inline uint32_t get_u32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+// 雙方用來比對棋盤是否一致的 checksum
+static inline uint32_t board_checksum(uint64_t black, uint64_t white) {
+    uint64_t h = black * 0x9e3779b97f4a7c15ULL;
+    h ^= (white * 0xc2b2ae3d27d4eb4fULL) >> 7;
+    h ^= h >> 29;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    return (uint32_t)(h ^ (h >> 32));
+}
+
+static inline void write_preamble(uint8_t* out) {
+    out[0] = 0x00;
+    out[1] = 'R';
+    out[2] = 'V';
+    out[3] = PROTOCOL_VERSION;
+}
+
+// 寫入一個完整 frame，回傳總長度；out 需至少 FRAME_HEADER_SIZE + length
+static inline size_t encode_frame(uint8_t* out, uint8_t opcode, const void* payload, size_t length) {
+    size_t frame_len = length + 1;
+    out[0] = (uint8_t)(frame_len >> 8);
+    out[1] = (uint8_t)(frame_len & 0xff);
+    out[2] = opcode;
+    if (length > 0) {
+        memcpy(out + FRAME_HEADER_SIZE, payload, length);
+    }
+    return FRAME_HEADER_SIZE + length;
+}
+
+static inline void encode_board(uint8_t* out, uint64_t black, uint64_t white) {
+    put_u64(out, black);
+    put_u64(out + 8, white);
+}
+
+// 文字協定中對應的指令名稱
+static inline const char* text_command(uint8_t opcode) {
+    switch (opcode) {
+        case OP_WAIT: return "WAIT";
+        case OP_START: return "START";
+        case OP_YOUR_TURN: return "YOUR_TURN";
+        case OP_OPPONENT_TURN: return "OPPONENT_TURN";
+        case OP_MOVE_OK: return "MOVE_OK";
+        case OP_INVALID: return "INVALID";
+        case OP_SKIP: return "SKIP";
+        case OP_OPPONENT_SKIP: return "OPPONENT_SKIP";
+        case OP_END: return "END";
+        case OP_OPPONENT_DISCONNECT: return "OPPONENT_DISCONNECT";
+        default: return "";
+    }
+}
+
+// 串流解碼器：一次 read() 可能只有半個 frame，也可能有好幾個 frame
+class FrameDecoder {
+private:
+    uint8_t buffer[DECODER_BUFFER_SIZE];
+    size_t start;
+    size_t end;
+    bool malformed;
+
+    void compact() {
+        if (start == 0) return;
+        memmove(buffer, buffer + start, end - start);
+        end -= start;
+        start = 0;
+    }
+
+public:
+    FrameDecoder() : start(0), end(0), malformed(false) {}
+
+    // 連線物件重複使用時清空狀態
+    void reset() {
+        start = 0;
+        end = 0;
+        malformed = false;
+    }
+
+    // 直接 read() 進內部 buffer，省去一次複製
+    uint8_t* write_ptr() {
+        if (end == DECODER_BUFFER_SIZE) compact();
+        return buffer + end;
+    }
+    size_t write_space() {
+        if (end == DECODER_BUFFER_SIZE) compact();
+        return DECODER_BUFFER_SIZE - end;
+    }
+    void commit(size_t n) { end += n; }
+
+    bool feed(const void* data, size_t n) {
+        if (n > write_space()) {
+            compact();
+            if (n > write_space()) return false;
+        }
+        memcpy(buffer + end, data, n);
+        end += n;
+        return true;
+    }
+
+    size_t available() const { return end - start; }
+    const uint8_t* data() const { return buffer + start; }
+
+    void consume(size_t n) {
+        start += n;
+        if (start == end) start = end = 0;
+    }
+
+    // 取出下一個完整 frame；payload 指向內部 buffer，在下一次 next/commit 前有效
+    bool next(Frame& f) {
+        if (malformed || end - start < FRAME_HEADER_SIZE) return false;
+
+        size_t frame_len = ((size_t)buffer[start] << 8) | buffer[start + 1];
+        if (frame_len == 0 || frame_len > MAX_PAYLOAD_SIZE + 1) {
+            malformed = true;
+            return false;
+        }
+        if (end - start < 2 + frame_len) {
+            return false;
+        }
+
+        f.opcode = buffer[start + 2];
+        f.payload = buffer + start + FRAME_HEADER_SIZE;
+        f.length = frame_len - 1;
+        start += 2 + frame_len;
+        if (start == end) start = end = 0;
+        return true;
+    }
+
+    bool is_malformed() const { return malformed; }
+};
+
+// 每條連線固定大小的環狀輸出緩衝區：frame 直接編碼進來，累積一輪後以一次 writev 送出，
+// 送不完的部分留在緩衝區等 socket 可寫；容量 OUTPUT_BUFFER_SIZE 必須是 2 的次方
+class OutputBuffer {
+private:
+    uint8_t buffer[OUTPUT_BUFFER_SIZE];
+    size_t head;   // 下一個要送出的位置
+    size_t used;
+
+public:
+    OutputBuffer() : head(0), used(0) {}
+
+    void reset() {
+        head = 0;
+        used = 0;
+    }
+
+    // 空間不足時整筆不寫入，回傳 false
+    bool append(const void* data, size_t n) {
+        if (n > OUTPUT_BUFFER_SIZE - used) return false;
+        size_t tail = (head + used) & (OUTPUT_BUFFER_SIZE - 1);
+        size_t first = OUTPUT_BUFFER_SIZE - tail;
+        if (first > n) first = n;
+        memcpy(buffer + tail, data, first);
+        memcpy(buffer, (const uint8_t*)data + first, n - first);
+        used += n;
+        return true;
+    }
+
+    bool append_frame(uint8_t opcode, const void* payload, size_t length) {
+        uint8_t frame[MAX_FRAME_SIZE];
+        size_t n = encode_frame(frame, opcode, payload, length);
+        return append(frame, n);
+    }
+
+    // 待送出的資料最多分成兩段（繞回開頭時），填入 iov 並回傳段數
+    int fill_iovec(struct iovec* iov) const {
+        if (used == 0) return 0;
+        size_t first = OUTPUT_BUFFER_SIZE - head;
+        if (first >= used) {
+            iov[0].iov_base = (void*)(buffer + head);
+            iov[0].iov_len = used;
+            return 1;
+        }
+        iov[0].iov_base = (void*)(buffer + head);
+        iov[0].iov_len = first;
+        iov[1].iov_base = (void*)buffer;
+        iov[1].iov_len = used - first;
+        return 2;
+    }
+
+    void consume(size_t n) {
+        used -= n;
+        head = (used == 0) ? 0 : ((head + n) & (OUTPUT_BUFFER_SIZE - 1));
+    }
+
+    size_t size() const { return used; }
+    bool empty() const { return used == 0; }
+};
+
+#endif // PROTOCOL_HPP
@@ -0,0 +1,310 @@
+#ifndef RECORD_HPP
+#define RECORD_HPP
+
+#include <stdint.h>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "game.hpp"
+#include "protocol.hpp"
+
+// 對局紀錄檔：只會在尾端附加，可以整個 mmap 進來依序走訪
+//   檔頭 8 bytes：'R' 'V' 'G' 'R' + 版本（4 bytes，big-endian）
+//   每筆紀錄：[長度 2 bytes，不含長度欄位本身][結束時間 8 bytes，Unix 秒]
+//             [結果 1 byte（GameResult）][結束原因 1 byte]
+//             [X 名字長度 1 byte][X 名字][O 名字長度 1 byte][O 名字]
+//             [步數 1 byte][每步 1 byte 位置（row * 8 + col）]
+//   pass 不記錄：重播時輪到的一方沒有合法位置就自動換手
+#define RECORD_MAGIC "RVGR"
+#define RECORD_VERSION 1
+#define RECORD_HEADER_SIZE 8
+#define RECORD_MAX_MOVES 64
+#define RECORD_MAX_SIZE (2 + 8 + 2 + 2 * (1 + MAX_NAME_LENGTH) + 1 + RECORD_MAX_MOVES)
+#define RECORD_MAX_PENDING (4 * 1024 * 1024)   // 寫入跟不上時最多暫存的 bytes，超過就丟棄並計數
+
+enum RecordEnd {
+    RECORD_END_NORMAL = 0,       // 下到終局
+    RECORD_END_DISCONNECT = 1,   // 一方斷線，對手獲勝
+    RECORD_END_TIMEOUT = 2       // 一方超過每步時限，對手獲勝
+};
+
+// 指向紀錄檔內容的一筆紀錄（不複製，名字不以 '\0' 結尾）
+struct RecordView {
+    uint64_t time;
+    uint8_t result;
+    uint8_t reason;
+    const char* black_name;
+    size_t black_length;
+    const char* white_name;
+    size_t white_length;
+    const uint8_t* moves;
+    size_t move_count;
+};
+
+// 編碼一筆紀錄，回傳長度；out 需至少 RECORD_MAX_SIZE
+static inline size_t encode_record(uint8_t* out, uint64_t time, uint8_t result, uint8_t reason,
+                                   const char* black_name, const char* white_name,
+                                   const uint8_t* moves, size_t move_count) {
+    size_t black_length = strnlen(black_name, MAX_NAME_LENGTH);
+    size_t white_length = strnlen(white_name, MAX_NAME_LENGTH);
+    if (move_count > RECORD_MAX_MOVES) move_count = RECORD_MAX_MOVES;
+
+    uint8_t* p = out + 2;
+    put_u64(p, time);
+    p += 8;
+    *p++ = result;
+    *p++ = reason;
+    *p++ = (uint8_t)black_length;
+    memcpy(p, black_name, black_length);
+    p += black_length;
+    *p++ = (uint8_t)white_length;
+    memcpy(p, white_name, white_length);
+    p += white_length;
+    *p++ = (uint8_t)move_count;
+    memcpy(p, moves, move_count);
+    p += move_count;
+
+    size_t length = p - out - 2;
+    out[0] = (uint8_t)(length >> 8);
+    out[1] = (uint8_t)(length & 0xff);
+    return p - out;
+}
+
+// 依紀錄的棋步重建對局；棋步不合法、或下到終局的紀錄結果與棋盤不符時回傳 false
+static inline bool replay_record(const RecordView& r, Game& game) {
+    game = Game();
+    char player = 'X';
+    for (size_t i = 0; i < r.move_count; i++) {
+        if (!game.has_valid_moves(player)) {
+            player = (player == 'X') ? 'O' : 'X';
+        }
+        int sq = r.moves[i];
+        if (sq >= 64 || !game.make_move(sq / 8, sq % 8, player)) {
+            return false;
+        }
+        player = (player == 'X') ? 'O' : 'X';
+    }
+
+    if (r.reason != RECORD_END_NORMAL) return r.result != RESULT_DRAW;
+    if (!game.is_game_over()) return false;
+    int black = game.get_black_count();
+    int white = game.get_white_count();
+    uint8_t expected = black > white ? RESULT_X_WINS : (white > black ? RESULT_O_WINS : RESULT_DRAW);
+    return r.result == expected;
+}
+
+// 以 mmap 唯讀開啟紀錄檔，依序取出每筆紀錄
+class RecordReader {
+private:
+    const uint8_t* base;
+    size_t size;
+    size_t offset;
+    bool truncated;   // 尾端有不完整的紀錄（例如寫到一半當機）
+
+public:
+    RecordReader() : base(NULL), size(0), offset(0), truncated(false) {}
+
+    ~RecordReader() {
+        if (base != NULL) munmap((void*)base, size);
+    }
+
+    bool open(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "Cannot open " << path << ": " << strerror(errno) << "\n";
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) < 0 || st.st_size < RECORD_HEADER_SIZE) {
+            std::cerr << path << ": not a game record file\n";
+            close(fd);
+            return false;
+        }
+        size = st.st_size;
+        void* p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) {
+            std::cerr << "mmap failed: " << strerror(errno) << "\n";
+            size = 0;
+            return false;
+        }
+        base = (const uint8_t*)p;
+        if (memcmp(base, RECORD_MAGIC, 4) != 0 || get_u32(base + 4) != RECORD_VERSION) {
+            std::cerr << path << ": not a game record file (or unsupported version)\n";
+            return false;
+        }
+        offset = RECORD_HEADER_SIZE;
+        return true;
+    }
+
+    bool next(RecordView& r) {
+        if (base == NULL || offset + 2 > size) return false;
+        size_t length = ((size_t)base[offset] << 8) | base[offset + 1];
+        const uint8_t* p = base + offset + 2;
+        const uint8_t* end = p + length;
+        if (offset + 2 + length > size || length < 8 + 5) {
+            truncated = true;
+            return false;
+        }
+
+        r.time = get_u64(p);
+        p += 8;
+        r.result = *p++;
+        r.reason = *p++;
+        r.black_length = *p++;
+        r.black_name = (const char*)p;
+        p += r.black_length;
+        if (p >= end) {
+            truncated = true;
+            return false;
+        }
+        r.white_length = *p++;
+        r.white_name = (const char*)p;
+        p += r.white_length;
+        if (p >= end) {
+            truncated = true;
+            return false;
+        }
+        r.move_count = *p++;
+        r.moves = p;
+        if (p + r.move_count != end) {
+            truncated = true;
+            return false;
+        }
+
+        offset += 2 + length;
+        return true;
+    }
+
+    bool is_truncated() const { return truncated; }
+};
+
+// 附加寫入紀錄檔：對局執行緒只把編碼好的紀錄複製進暫存區，由背景執行緒寫檔，
+// 不會因為磁碟慢而卡住下棋；暫存超過 RECORD_MAX_PENDING 時丟棄並計數
+class RecordWriter {
+private:
+    int fd;
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::vector<uint8_t> pending;    // 對局執行緒寫入這裡
+    std::vector<uint8_t> writing;    // 背景執行緒交換過來後寫檔，兩塊輪流使用、保留容量
+    bool stopping;
+    std::thread thread;
+    std::atomic<uint64_t> records;
+    std::atomic<uint64_t> dropped;
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            ready.wait(lock, [this]() { return stopping || !pending.empty(); });
+            if (pending.empty() && stopping) return;
+            pending.swap(writing);
+            lock.unlock();
+
+            size_t done = 0;
+            while (done < writing.size()) {
+                ssize_t n = write(fd, writing.data() + done, writing.size() - done);
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) {
+                    std::cerr << "Game record write failed: " << strerror(errno) << "\n";
+                    break;
+                }
+                done += n;
+            }
+            writing.clear();
+            lock.lock();
+        }
+    }
+
+public:
+    RecordWriter() : fd(-1), stopping(false), records(0), dropped(0) {}
+
+    ~RecordWriter() { close(); }
+
+    // 檔案不存在時建立並寫入檔頭；已存在時檢查檔頭後接在尾端
+    bool open(const std::string& path) {
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+        if (fd < 0) {
+            std::cerr << "Cannot open game record " << path << ": " << strerror(errno) << "\n";
+            return false;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) < 0) {
+            std::cerr << "Cannot stat game record " << path << "\n";
+            return false;
+        }
+        if (st.st_size == 0) {
+            uint8_t header[RECORD_HEADER_SIZE];
+            memcpy(header, RECORD_MAGIC, 4);
+            put_u32(header + 4, RECORD_VERSION);
+            if (write(fd, header, sizeof(header)) != (ssize_t)sizeof(header)) {
+                std::cerr << "Cannot write game record header\n";
+                return false;
+            }
+        } else {
+            uint8_t header[RECORD_HEADER_SIZE];
+            if (pread(fd, header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+                memcmp(header, RECORD_MAGIC, 4) != 0 || get_u32(header + 4) != RECORD_VERSION) {
+                std::cerr << path << " exists and is not a game record file\n";
+                return false;
+            }
+        }
+
+        pending.reserve(64 * 1024);
+        writing.reserve(64 * 1024);
+        thread = std::thread(&RecordWriter::run, this);
+        return true;
+    }
+
+    bool is_open() const { return fd != -1; }
+
+    // 由對局執行緒呼叫；只做一次 memcpy，不等待磁碟
+    void append(const uint8_t* data, size_t length) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (pending.size() + length > RECORD_MAX_PENDING) {
+                dropped++;
+                return;
+            }
+            pending.insert(pending.end(), data, data + length);
+        }
+        records++;
+        ready.notify_one();
+    }
+
+    // 寫完暫存的紀錄後關檔
+    void close() {
+        if (thread.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            ready.notify_one();
+            thread.join();
+        }
+        if (fd != -1) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+
+    uint64_t get_records() const { return records; }
+    uint64_t get_dropped() const { return dropped; }
+
+private:
+    RecordWriter(const RecordWriter&);
+    RecordWriter& operator=(const RecordWriter&);
+};
+
+#endif // RECORD_HPP
@@ -0,0 +1,124 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <cstdlib>
+#include <ctime>
+#include <stdint.h>
+#include "game.hpp"
+#include "record.hpp"
+
+static const char* result_text(uint8_t result) {
+    switch (result) {
+        case RESULT_X_WINS: return "X wins";
+        case RESULT_O_WINS: return "O wins";
+        default: return "Draw";
+    }
+}
+
+static const char* reason_text(uint8_t reason) {
+    switch (reason) {
+        case RECORD_END_NORMAL: return "";
+        case RECORD_END_DISCONNECT: return " (disconnect)";
+        case RECORD_END_TIMEOUT: return " (timeout)";
+        default: return " (?)";
+    }
+}
+
+static std::string format_time(uint64_t seconds) {
+    time_t t = (time_t)seconds;
+    struct tm local;
+    char text[32];
+    localtime_r(&t, &local);
+    strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &local);
+    return text;
+}
+
+static void print_board(const Game& game) {
+    std::string board = game.get_board_state();
+    std::cout << "  a b c d e f g h\n";
+    for (int row = 0; row < 8; row++) {
+        std::cout << (8 - row);
+        for (int col = 0; col < 8; col++) {
+            std::cout << ' ' << (board[row * 8 + col] == '*' ? '.' : board[row * 8 + col]);
+        }
+        std::cout << "\n";
+    }
+}
+
+// 列出所有對局，並以 Game::make_move 重播驗證每一筆
+static int list_games(RecordReader& reader) {
+    RecordView r;
+    int count = 0;
+    int failed = 0;
+    while (reader.next(r)) {
+        Game game;
+        bool ok = replay_record(r, game);
+        if (!ok) failed++;
+        std::cout << std::setw(6) << count << "  " << format_time(r.time) << "  "
+                  << std::string(r.black_name, r.black_length) << " (X) vs "
+                  << std::string(r.white_name, r.white_length) << " (O), "
+                  << r.move_count << " moves, " << result_text(r.result) << reason_text(r.reason)
+                  << " " << game.get_black_count() << "-" << game.get_white_count()
+                  << (ok ? "" : "  REPLAY FAILED") << "\n";
+        count++;
+    }
+    if (reader.is_truncated()) {
+        std::cout << "warning: the file ends with an incomplete record\n";
+    }
+    std::cout << count << " games, " << failed << " failed to replay\n";
+    return failed == 0 ? 0 : 1;
+}
+
+// 逐步重播一盤棋
+static int show_game(RecordReader& reader, int index) {
+    RecordView r;
+    for (int i = 0; i <= index; i++) {
+        if (!reader.next(r)) {
+            std::cout << "No game #" << index << "\n";
+            return 1;
+        }
+    }
+
+    std::cout << "#" << index << "  " << format_time(r.time) << "\n"
+              << "X: " << std::string(r.black_name, r.black_length) << "\n"
+              << "O: " << std::string(r.white_name, r.white_length) << "\n";
+
+    Game game;
+    char player = 'X';
+    for (size_t i = 0; i < r.move_count; i++) {
+        if (!game.has_valid_moves(player)) {
+            std::cout << std::setw(4) << "" << player << " passes\n";
+            player = (player == 'X') ? 'O' : 'X';
+        }
+        int sq = r.moves[i];
+        if (sq >= 64 || !game.make_move(sq / 8, sq % 8, player)) {
+            std::cout << "Illegal move at ply " << i + 1 << "\n";
+            return 1;
+        }
+        std::cout << std::setw(3) << i + 1 << " " << player << " " << game.format_move(sq / 8, sq % 8)
+                  << "  " << std::setw(2) << game.get_black_count() << "-" << game.get_white_count() << "\n";
+        player = (player == 'X') ? 'O' : 'X';
+    }
+
+    print_board(game);
+    bool ok = replay_record(r, game);
+    std::cout << "Result: " << result_text(r.result) << reason_text(r.reason)
+              << (ok ? "" : "  (does not match the board)") << "\n";
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2 || argc > 3) {
+        std::cout << "Usage: " << argv[0] << " <record_file> [game_index]\n";
+        return 1;
+    }
+
+    RecordReader reader;
+    if (!reader.open(argv[1])) {
+        return 1;
+    }
+    if (argc == 3) {
+        return show_game(reader, atoi(argv[2]));
+    }
+    return list_games(reader);
+}
\ No newline at end of file
@@ -0,0 +1,292 @@
+#ifndef SEARCH_HPP
+#define SEARCH_HPP
+
+#include <stdint.h>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "game.hpp"
+#include "transposition.hpp"
+#include "eval.hpp"
+
+#define SEARCH_MAX_DEPTH 60
+#define SCORE_INF 30000
+#define SCORE_WIN 10000            // 終局分數：SCORE_WIN + 子數差（需放得進置換表的 16 bits）
+#define TIME_CHECK_INTERVAL 1024   // 每搜尋幾個節點檢查一次時間
+
+struct SearchResult {
+    int move;          // 位置 row * 8 + col，-1 表示沒有合法位置
+    int score;         // 以 player 的角度
+    int depth;         // 完整搜尋完成的深度
+    uint64_t nodes;
+    double seconds;
+};
+
+// negamax alpha-beta 搜尋，搭配 iterative deepening、置換表與每步時間限制
+// 輪到誰由 Game::get_current_player() 決定，讓 Zobrist hash 包含行棋方
+//
+// 多執行緒時採 Lazy SMP：helper 執行緒用錯開的深度與根節點順序搜尋同一個局面，
+// 只透過共用的置換表互相幫忙；結果永遠取主執行緒的。置換表只在深度剛好相同時
+// 截斷，helper 寫入的較深資料只影響排序，因此固定深度時結果與單執行緒相同。
+class Searcher {
+private:
+    TranspositionTable* tt;   // 可為 NULL（不使用置換表）
+    const PatternEvaluator* evaluator;   // 可為 NULL（使用下面的位置權重評估）
+    int threads;
+    uint64_t nodes;
+    bool stopped;
+    bool has_deadline;
+    std::chrono::steady_clock::time_point deadline;
+    const std::atomic<bool>* abort;   // helper 用：主執行緒搜尋結束時設為 true
+
+    static int square_weight(int sq) {
+        static const int weights[64] = {
+            100, -20,  10,   5,   5,  10, -20, 100,
+            -20, -50,  -2,  -2,  -2,  -2, -50, -20,
+             10,  -2,  -1,  -1,  -1,  -1,  -2,  10,
+              5,  -2,  -1,  -1,  -1,  -1,  -2,   5,
+              5,  -2,  -1,  -1,  -1,  -1,  -2,   5,
+             10,  -2,  -1,  -1,  -1,  -1,  -2,  10,
+            -20, -50,  -2,  -2,  -2,  -2, -50, -20,
+            100, -20,  10,   5,   5,  10, -20, 100
+        };
+        return weights[sq];
+    }
+
+    static char opponent_of(char player) { return player == 'X' ? 'O' : 'X'; }
+
+    // 靜態評估：有樣式評估時用它（限制在終局分數之內），否則為位置權重加上行動力差
+    int evaluate(const Game& game, char player) const {
+        uint64_t own = (player == 'X') ? game.get_black_board() : game.get_white_board();
+        uint64_t opp = (player == 'X') ? game.get_white_board() : game.get_black_board();
+        if (evaluator != NULL) {
+            int score = evaluator->evaluate(own, opp);
+            if (score >= SCORE_WIN) return SCORE_WIN - 1;
+            if (score <= -SCORE_WIN) return -SCORE_WIN + 1;
+            return score;
+        }
+
+        int score = 0;
+        for (uint64_t b = own; b; b &= b - 1) score += square_weight(__builtin_ctzll(b));
+        for (uint64_t b = opp; b; b &= b - 1) score -= square_weight(__builtin_ctzll(b));
+
+        int own_moves = __builtin_popcountll(game.get_valid_moves(player));
+        int opp_moves = __builtin_popcountll(game.get_valid_moves(opponent_of(player)));
+        score += 10 * (own_moves - opp_moves);
+        return score;
+    }
+
+    static int final_score(const Game& game, char player) {
+        int diff = game.get_black_count() - game.get_white_count();
+        if (player == 'O') diff = -diff;
+        if (diff > 0) return SCORE_WIN + diff;
+        if (diff < 0) return -SCORE_WIN + diff;
+        return 0;
+    }
+
+    // 置換表記錄的最佳步優先，其餘依位置權重排序：角落優先，X 位置最後
+    static int order_moves(uint64_t moves, int* list, int hash_move) {
+        int n = 0;
+        if (hash_move != TT_NO_MOVE && (moves & (1ULL << hash_move))) {
+            list[n++] = hash_move;
+            moves &= ~(1ULL << hash_move);
+        }
+        int first = n;
+        for (uint64_t b = moves; b; b &= b - 1) {
+            int sq = __builtin_ctzll(b);
+            int i = n++;
+            while (i > first && square_weight(list[i - 1]) < square_weight(sq)) {
+                list[i] = list[i - 1];
+                i--;
+            }
+            list[i] = sq;
+        }
+        return n;
+    }
+
+    bool out_of_time() {
+        if (stopped) return true;
+        if ((nodes % TIME_CHECK_INTERVAL) == 0) {
+            if (abort != NULL && abort->load(std::memory_order_relaxed)) {
+                stopped = true;
+            } else if (has_deadline && std::chrono::steady_clock::now() >= deadline) {
+                stopped = true;
+            }
+        }
+        return stopped;
+    }
+
+    int negamax(const Game& game, int depth, int alpha, int beta) {
+        nodes++;
+        if (out_of_time()) return 0;
+
+        char player = game.get_current_player();
+        char opponent = opponent_of(player);
+        uint64_t moves = game.get_valid_moves(player);
+
+        if (moves == 0) {
+            if (!game.has_valid_moves(opponent)) {
+                return final_score(game, player);
+            }
+            // 沒棋可下就 pass，不消耗深度
+            Game passed = game;
+            passed.set_current_player(opponent);
+            return -negamax(passed, depth, -beta, -alpha);
+        }
+
+        if (depth == 0) {
+            return evaluate(game, player);
+        }
+
+        int hash_move = TT_NO_MOVE;
+        TTProbe entry;
+        if (tt != NULL && tt->probe(game.get_hash(), entry)) {
+            hash_move = entry.move;
+            if (entry.depth == depth) {
+                if (entry.bound == BOUND_EXACT) return entry.score;
+                if (entry.bound == BOUND_LOWER && entry.score >= beta) return entry.score;
+                if (entry.bound == BOUND_UPPER && entry.score <= alpha) return entry.score;
+            }
+        }
+
+        int alpha_orig = alpha;
+        int list[64];
+        int n = order_moves(moves, list, hash_move);
+        int best = -SCORE_INF;
+        int best_move = list[0];
+
+        for (int i = 0; i < n; i++) {
+            Game child = game;
+            child.make_move(list[i] / 8, list[i] % 8, player);
+            int score = -negamax(child, depth - 1, -beta, -alpha);
+            if (stopped) return 0;
+
+            if (score > best) {
+                best = score;
+                best_move = list[i];
+                if (score > alpha) {
+                    alpha = score;
+                    if (alpha >= beta) break;
+                }
+            }
+        }
+
+        if (tt != NULL) {
+            int bound = best <= alpha_orig ? BOUND_UPPER : (best >= beta ? BOUND_LOWER : BOUND_EXACT);
+            tt->store(game.get_hash(), depth, bound, best, best_move);
+        }
+        return best;
+    }
+
+    // 從 root 開始做 iterative deepening；helper 以 start_depth 與 rotate 錯開主執行緒
+    void iterate(const Game& root, char player, int start_depth, int max_depth, int rotate,
+                 SearchResult& result) {
+        int list[64];
+        int scores[64];
+        int n = order_moves(root.get_valid_moves(player), list, TT_NO_MOVE);
+        if (n > 0) {
+            result.move = list[0];
+        }
+        for (int r = 0; n > 1 && r < rotate % n; r++) {
+            int first = list[0];
+            for (int i = 0; i < n - 1; i++) list[i] = list[i + 1];
+            list[n - 1] = first;
+        }
+
+        for (int depth = start_depth; depth <= max_depth && n > 0; depth++) {
+            int alpha = -SCORE_INF;
+            int best_index = 0;
+
+            for (int i = 0; i < n; i++) {
+                Game child = root;
+                child.make_move(list[i] / 8, list[i] % 8, player);
+                scores[i] = -negamax(child, depth - 1, -SCORE_INF, -alpha);
+                if (stopped) break;
+                if (scores[i] > alpha) {
+                    alpha = scores[i];
+                    best_index = i;
+                }
+            }
+            if (stopped) break;  // 未完成的這一層不採用
+
+            result.move = list[best_index];
+            result.score = alpha;
+            result.depth = depth;
+
+            // 下一層先搜尋本層最佳的一步
+            int best_move = list[best_index];
+            for (int i = best_index; i > 0; i--) {
+                list[i] = list[i - 1];
+            }
+            list[0] = best_move;
+
+            // 勝負已定就不用再加深
+            if (alpha >= SCORE_WIN || alpha <= -SCORE_WIN) break;
+        }
+    }
+
+public:
+    explicit Searcher(TranspositionTable* table = NULL, int thread_count = 1)
+        : tt(table), evaluator(NULL), threads(thread_count > 0 ? thread_count : 1), nodes(0), stopped(false),
+          has_deadline(false), abort(NULL) {}
+
+    // 評估器必須在搜尋期間一直存在；多個 Searcher 可共用同一個
+    void set_evaluator(const PatternEvaluator* pattern_evaluator) { evaluator = pattern_evaluator; }
+
+    // time_ms <= 0 表示不限時間，只看 max_depth
+    SearchResult search(const Game& game, char player, int max_depth, int time_ms) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        nodes = 0;
+        stopped = false;
+        has_deadline = time_ms > 0;
+        deadline = start + std::chrono::milliseconds(time_ms);
+
+        SearchResult result;
+        result.move = -1;
+        result.score = 0;
+        result.depth = 0;
+
+        Game root = game;
+        root.set_current_player(player);
+        if (tt != NULL) {
+            tt->new_search();
+        }
+
+        if (max_depth > SEARCH_MAX_DEPTH) max_depth = SEARCH_MAX_DEPTH;
+
+        // 沒有置換表時 helper 無法分享任何結果，不啟動
+        int helper_count = (tt != NULL) ? threads - 1 : 0;
+        std::atomic<bool> done(false);
+        std::vector<Searcher> helpers(helper_count, Searcher(tt));
+        std::vector<SearchResult> helper_results(helper_count);
+        std::vector<std::thread> workers;
+
+        for (int i = 0; i < helper_count; i++) {
+            Searcher* helper = &helpers[i];
+            SearchResult* helper_result = &helper_results[i];
+            helper->abort = &done;
+            helper->evaluator = evaluator;
+            helper->has_deadline = has_deadline;
+            helper->deadline = deadline;
+            workers.push_back(std::thread([helper, helper_result, &root, player, max_depth, i]() {
+                helper->iterate(root, player, 1 + (i + 1) % 2, max_depth, i + 1, *helper_result);
+            }));
+        }
+
+        iterate(root, player, 1, max_depth, 0, result);
+
+        done.store(true, std::memory_order_relaxed);
+        uint64_t total = nodes;
+        for (int i = 0; i < helper_count; i++) {
+            workers[i].join();
+            total += helpers[i].nodes;
+        }
+
+        result.nodes = total;
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return result;
+    }
+};
+
+#endif // SEARCH_HPP
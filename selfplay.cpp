@@ -0,0 +1,239 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <ctime>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <stdint.h>
+#include "game.hpp"
+#include "search.hpp"
+#include "transposition.hpp"
+#include "endgame.hpp"
+#include "eval.hpp"
+#include "record.hpp"
+#include "thread_pool.hpp"
+
+#define SELFPLAY_DEFAULT_GAMES 1000
+#define SELFPLAY_DEFAULT_DEPTH 6
+#define SELFPLAY_DEFAULT_RANDOM_PLIES 8     // 開局隨機下幾步，讓每盤棋都不同
+#define SELFPLAY_DEFAULT_ENDGAME 14         // 剩下幾個空格以內改用殘局求解（0 表示不用）
+#define SELFPLAY_TT_MB 16                   // 每個 worker 自己的置換表，不互相搶 cache line
+#define SELFPLAY_BATCH_BYTES (16 * 1024)    // 每個 worker 累積這麼多紀錄才交給 RecordWriter
+
+struct SelfPlayOptions {
+    std::string output;
+    std::string weights_path;
+    int games;
+    int depth;
+    int random_plies;
+    int endgame_empties;
+    int threads;
+    unsigned int seed;
+};
+
+// 每個 worker 的狀態：置換表、殘局雜湊表與尚未交出的紀錄只由該 worker 使用
+struct SelfPlayWorker {
+    TranspositionTable* tt;
+    EndgameSolver* solver;   // 雜湊表存的是分數上下界，換局面繼續沿用也正確
+    std::vector<uint8_t> batch;
+    uint64_t games;
+    uint64_t moves;
+};
+
+struct SelfPlayTotals {
+    std::atomic<uint64_t> games;
+    std::atomic<uint64_t> moves;
+    std::atomic<uint64_t> x_wins;
+    std::atomic<uint64_t> o_wins;
+    std::atomic<uint64_t> draws;
+};
+
+static int pick_random_move(uint64_t moves, unsigned int& seed) {
+    int pick = rand_r(&seed) % __builtin_popcountll(moves);
+    for (int k = 0; k < pick; k++) moves &= moves - 1;
+    return __builtin_ctzll(moves);
+}
+
+// 下完一盤棋並編碼成一筆紀錄；隨機開局只由種子與盤號決定，與哪個 worker 執行無關
+static size_t play_game(const SelfPlayOptions& options, const PatternEvaluator* evaluator, int game_index,
+                        SelfPlayWorker& worker, SelfPlayTotals& totals, uint8_t* out) {
+    unsigned int seed = options.seed + (unsigned int)game_index * 2654435761u;
+    Game game;
+    char player = 'X';
+    uint8_t moves[RECORD_MAX_MOVES];
+    size_t count = 0;
+
+    while (!game.is_game_over()) {
+        uint64_t legal = game.get_valid_moves(player);
+        if (legal == 0) {
+            player = (player == 'X') ? 'O' : 'X';
+            continue;
+        }
+
+        int sq;
+        if ((int)count < options.random_plies) {
+            sq = pick_random_move(legal, seed);
+        } else if (EndgameSolver::empties(game) <= options.endgame_empties) {
+            sq = worker.solver->solve(game, player).move;
+        } else {
+            Searcher searcher(worker.tt);
+            searcher.set_evaluator(evaluator);
+            sq = searcher.search(game, player, options.depth, 0).move;
+        }
+        game.make_move(sq / 8, sq % 8, player);
+        moves[count++] = (uint8_t)sq;
+        player = (player == 'X') ? 'O' : 'X';
+    }
+
+    int black = game.get_black_count();
+    int white = game.get_white_count();
+    uint8_t result = black > white ? RESULT_X_WINS : (white > black ? RESULT_O_WINS : RESULT_DRAW);
+    if (result == RESULT_X_WINS) totals.x_wins++;
+    else if (result == RESULT_O_WINS) totals.o_wins++;
+    else totals.draws++;
+    totals.games++;
+    totals.moves += count;
+    worker.games++;
+    worker.moves += count;
+
+    std::string name = "selfplay-d" + std::to_string(options.depth);
+    return encode_record(out, (uint64_t)time(NULL), result, RECORD_END_NORMAL, name.c_str(), name.c_str(),
+                         moves, count);
+}
+
+static int run(const SelfPlayOptions& options) {
+    PatternEvaluator* evaluator = NULL;
+    if (!options.weights_path.empty()) {
+        evaluator = new PatternEvaluator();
+        if (!evaluator->load(options.weights_path)) {
+            delete evaluator;
+            return 1;
+        }
+    }
+
+    RecordWriter writer;
+    if (!writer.open(options.output)) return 1;
+
+    std::vector<SelfPlayWorker> workers(options.threads);
+    for (int i = 0; i < options.threads; i++) {
+        workers[i].tt = new TranspositionTable(SELFPLAY_TT_MB);
+        workers[i].solver = new EndgameSolver();
+        workers[i].batch.reserve(SELFPLAY_BATCH_BYTES + RECORD_MAX_SIZE);
+        workers[i].games = 0;
+        workers[i].moves = 0;
+    }
+    SelfPlayTotals totals;
+    totals.games = 0;
+    totals.moves = 0;
+    totals.x_wins = 0;
+    totals.o_wins = 0;
+    totals.draws = 0;
+
+    std::cout << "playing " << options.games << " games at depth " << options.depth << " on "
+              << options.threads << " threads (" << options.random_plies << " random plies, endgame "
+              << options.endgame_empties << " empties" << (evaluator ? ", pattern evaluation" : "") << ")\n";
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    {
+        WorkStealingPool pool(options.threads);
+        for (int g = 0; g < options.games; g++) {
+            pool.submit([&options, evaluator, g, &workers, &totals, &writer](int index) {
+                SelfPlayWorker& worker = workers[index];
+                uint8_t record[RECORD_MAX_SIZE];
+                size_t length = play_game(options, evaluator, g, worker, totals, record);
+                worker.batch.insert(worker.batch.end(), record, record + length);
+                if (worker.batch.size() >= SELFPLAY_BATCH_BYTES) {
+                    writer.append(worker.batch.data(), worker.batch.size());
+                    worker.batch.clear();
+                }
+            });
+        }
+
+        while (!pool.wait_for(1000)) {
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "  " << totals.games << "/" << options.games << " games, " << std::fixed
+                      << std::setprecision(1) << totals.games / seconds << " games/s, "
+                      << pool.get_steals() << " steals\n" << std::flush;
+        }
+
+        std::cout << "steals: " << pool.get_steals() << "\n";
+    }
+
+    // pool 結束後 worker 不再執行，剩下的紀錄由這裡交出
+    for (int i = 0; i < options.threads; i++) {
+        if (!workers[i].batch.empty()) {
+            writer.append(workers[i].batch.data(), workers[i].batch.size());
+        }
+    }
+    writer.close();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "per thread:";
+    for (int i = 0; i < options.threads; i++) {
+        std::cout << " " << workers[i].games;
+        delete workers[i].tt;
+        delete workers[i].solver;
+    }
+    std::cout << " games\n";
+    std::cout << totals.games << " games, " << totals.moves << " moves in " << std::fixed
+              << std::setprecision(2) << seconds << " s (" << totals.games / seconds << " games/s, "
+              << (uint64_t)(totals.moves / seconds) << " moves/s)\n";
+    std::cout << "X wins " << totals.x_wins << ", O wins " << totals.o_wins << ", draws " << totals.draws << "\n";
+    delete evaluator;
+
+    if (writer.get_dropped() > 0) {
+        std::cerr << writer.get_dropped() << " record batches dropped (disk too slow)\n";
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cout << "Usage: " << argv[0] << " <record_file> [-g games] [-d depth] [-t threads]"
+                  << " [-o random_plies] [-e endgame_empties] [-s seed] [-w weights_file]\n";
+        return 1;
+    }
+
+    SelfPlayOptions options;
+    options.output = argv[1];
+    options.games = SELFPLAY_DEFAULT_GAMES;
+    options.depth = SELFPLAY_DEFAULT_DEPTH;
+    options.random_plies = SELFPLAY_DEFAULT_RANDOM_PLIES;
+    options.endgame_empties = SELFPLAY_DEFAULT_ENDGAME;
+    options.threads = std::thread::hardware_concurrency();
+    options.seed = (unsigned int)time(NULL);
+
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-g" && i + 1 < argc) {
+            options.games = atoi(argv[++i]);
+        } else if (arg == "-d" && i + 1 < argc) {
+            options.depth = atoi(argv[++i]);
+        } else if (arg == "-t" && i + 1 < argc) {
+            options.threads = atoi(argv[++i]);
+        } else if (arg == "-o" && i + 1 < argc) {
+            options.random_plies = atoi(argv[++i]);
+        } else if (arg == "-e" && i + 1 < argc) {
+            options.endgame_empties = atoi(argv[++i]);
+        } else if (arg == "-s" && i + 1 < argc) {
+            options.seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (arg == "-w" && i + 1 < argc) {
+            options.weights_path = argv[++i];
+        } else {
+            std::cout << "Unknown option: " << arg << "\n";
+            return 1;
+        }
+    }
+    if (options.games <= 0) options.games = SELFPLAY_DEFAULT_GAMES;
+    if (options.depth <= 0) options.depth = SELFPLAY_DEFAULT_DEPTH;
+    if (options.threads <= 0) options.threads = 1;
+    if (options.random_plies < 0) options.random_plies = 0;
+    if (options.endgame_empties < 0) options.endgame_empties = 0;
+    if (options.endgame_empties > ENDGAME_MAX_EMPTIES) options.endgame_empties = ENDGAME_MAX_EMPTIES;
+
+    return run(options);
+}
\ No newline at end of file
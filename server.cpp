@@ -1,256 +1,2079 @@
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <cstring>
+#include <deque>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <random>
+#include <condition_variable>
 #include <sys/socket.h>
-#include <sys/select.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
 #include <cstdlib>
 #include <ctime>
+#include <chrono>
 #include "game.hpp"
+#include "protocol.hpp"
+#include "search.hpp"
+#include "endgame.hpp"
+#include "ai_service.hpp"
+#include "pool.hpp"
+#include "timer_wheel.hpp"
+#include "record.hpp"
+#include "book.hpp"
+#include "eval.hpp"
+#include "broadcast.hpp"
+#include "snapshot.hpp"
+#include "metrics.hpp"
+#include "alloc_counter.hpp"
 
-#define BUFFER_SIZE 1024
+#define MAX_EVENTS 256
+#define AI_NAME "Computer"
+#define HELLO_TIMEOUT_SECONDS 60   // 連線後這段時間內沒送名字就斷線
+#define RESUME_TIMEOUT_SECONDS 60  // 還原的對局中，玩家這段時間內沒有回到座位就判負
+#define DRAIN_TIMEOUT_SECONDS 5    // 對局結束後觀眾最多等這麼久把 END 送完，之後直接斷線
+#define SPECTATOR_NAME "(spectator)"
+#define MATCH_DIRECTORY_SIZE 65536  // 2 的次方；同時進行的對局超過這個數時，較舊的對局可能查不到
+#define METRICS_WAIT_MS 1000        // 等 shard 交出統計快照的上限，忙碌的 shard 先用上一份
+
+// 伺服器設定（由命令列參數決定）
+struct ServerConfig {
+    bool verbose;          // 印出每一步棋
+    int threads;           // reactor 執行緒數
+    int ai_fill_seconds;   // 等待超過幾秒就由電腦補位，0 表示不補
+    int ai_time_ms;        // 電腦每步的思考時間
+    int tt_megabytes;      // 所有電腦共用的置換表大小
+    int search_threads;    // 電腦每步使用的搜尋執行緒數
+    int ai_workers;        // 電腦下棋的 worker 執行緒數，所有對局共用
+    int endgame_empties;   // 空格數不超過此值時電腦改用殘局求解，0 表示不用
+    int stats_seconds;     // 每隔幾秒印出棋步數與 heap 配置次數，0 表示不印
+    int turn_seconds;      // 每步的時限，超過視同斷線；0 表示不限
+    int heartbeat_seconds; // 二進位 client 這段時間沒有資料就送 PING，再一段時間沒回應就斷線；0 表示不檢查
+    std::string record_path; // 對局紀錄檔，空字串表示不記錄
+    std::string book_path;   // 開局庫，空字串表示不用
+    std::string weights_path; // 樣式評估的權重檔，空字串表示用位置權重評估
+    std::string snapshot_path; // 進行中對局的快照檔，空字串表示不保存
+    int metrics_port;      // 在 127.0.0.1 的這個 port 提供 Prometheus 格式的統計，0 表示不提供
+};
+
+enum ProtocolMode {
+    PROTO_UNKNOWN,   // 還沒收到第一個 byte
+    PROTO_TEXT,      // 舊版 client：冒號分隔的文字訊息
+    PROTO_BINARY     // 長度前綴的二進位 frame
+};
+
+struct Match;
+
+enum TimerKind {
+    TIMER_CONNECTION,   // 連線：送名字的期限，之後作為心跳
+    TIMER_TURN          // 對局：目前這一步的時限
+};
+
+// 一條客戶端連線；由 shard 的物件池配置，輸入與輸出緩衝區都在物件內
+struct Connection {
+    int fd;
+    char name[MAX_NAME_LENGTH + 1];
+    int protocol;
+    FrameDecoder decoder;
+    OutputBuffer output;
+    bool dirty;      // 本輪有新的輸出，已在 shard 的待送清單中
+    bool throttled;  // 輸出積太多、暫停讀取，等送出後再恢復
+    bool broken;     // 輸出緩衝區滿了或寫入失敗，本輪結束時斷線
+    Timer timer;
+    uint64_t last_heard;  // 最後一次收到資料的 tick
+    bool named;      // 是否已收到玩家名字
+    bool closed;     // 已關閉，等本輪事件處理完再釋放
+    bool is_ai;      // 電腦玩家：沒有 socket，訊息直接丟棄
+    bool vacant;     // 還原的對局中還沒回來的玩家：沒有 socket，訊息直接丟棄，等他用 token 回到座位
+    Match* match;
+    int seat;        // 在對局中的座位（0 或 1）
+    std::chrono::steady_clock::time_point wait_since;  // 進入配對佇列的時間
+    Match* watching;             // 觀戰中的對局，NULL 表示不是觀眾
+    Connection* watch_prev;      // 同一場對局的觀眾串列
+    Connection* watch_next;
+    FrameQueue frames;           // 觀眾的輸出：指向共用 frame，不使用 output
+    bool resync_pending;         // 跟不上而丟過更新，送完佇列後補一次完整棋盤
+    bool draining;               // 看的對局已結束：佇列送完（或逾時）才關閉，不再接收任何更新
+};
+
+// 電腦算好的一步，由搜尋執行緒交回 shard
+struct AIMove {
+    Match* match;
+    int match_id;    // 對局物件會重複使用，id 不同表示原本的對局已結束
+    int square;
+};
+
+// 一場對局；取代原本阻塞式 run_game() 的狀態機
+struct Match {
+    int id;          // 0 表示已結束、物件已放回池中
+    Game game;
+    Connection* players[2];
+    char pieces[2];
+    int current_turn;
+    int moves_played;
+    uint64_t legal;   // 目前輪到的一方的合法位置，每回合開始時算一次
+    Timer turn_timer;
+    uint8_t moves[RECORD_MAX_MOVES];   // 棋譜，寫入對局紀錄用
+    int end_reason;   // RecordEnd
+    int forfeit_seat; // 斷線或超時的一方，正常結束時為 -1
+    bool practice;    // 練習模式；電腦的要求排在正式對局之後
+    uint64_t secrets[2];  // 兩個座位的續局 token
+    int snapshot_slot;    // 快照檔中的格子，-1 表示沒有保存
+    bool snapshot_dirty;  // 本輪有變動，已在 shard 的待寫清單中
+    Connection* spectators;   // 觀眾串列的第一個
+    int spectator_count;
+};
+
+static std::atomic<int> next_match_id(0);
+
+class Shard;
+
+// 對局編號 -> 所在的 shard 與對局物件，讓連到任何 shard 的觀眾都找得到對局。
+// 只在對局開始、結束與觀眾加入時使用，一把鎖就夠；Match 只能由所在的 shard 讀取
+class MatchDirectory {
+private:
+    struct Entry {
+        int id;
+        Shard* shard;
+        Match* match;
+    };
+
+    std::mutex mutex;
+    std::vector<Entry> entries;   // 以 id 對應到固定位置，不配置記憶體
+    int latest;
+
+public:
+    MatchDirectory() : entries(MATCH_DIRECTORY_SIZE), latest(0) {
+        for (size_t i = 0; i < entries.size(); i++) {
+            entries[i].id = 0;
+        }
+    }
+
+    void add(int id, Shard* shard, Match* match) {
+        std::lock_guard<std::mutex> lock(mutex);
+        Entry& e = entries[id & (MATCH_DIRECTORY_SIZE - 1)];
+        e.id = id;
+        e.shard = shard;
+        e.match = match;
+        if (id > latest) latest = id;
+    }
+
+    void remove(int id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        Entry& e = entries[id & (MATCH_DIRECTORY_SIZE - 1)];
+        if (e.id == id) e.id = 0;
+    }
+
+    // id 為 0 時找最新開始、仍在進行的對局
+    bool find(int id, Shard*& shard, Match*& match) {
+        std::lock_guard<std::mutex> lock(mutex);
+        int first = (id > 0) ? id : latest;
+        int last = (id > 0) ? id : std::max(1, latest - MATCH_DIRECTORY_SIZE + 1);
+        for (int k = first; k >= last; k--) {
+            const Entry& e = entries[k & (MATCH_DIRECTORY_SIZE - 1)];
+            if (e.id == k) {
+                shard = e.shard;
+                match = e.match;
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+// acceptor 交給 shard 的新連線，附上 accept 的時間（統計交接延遲用）
+struct PendingConnection {
+    int fd;
+    uint64_t accepted_at;
+};
+
+// 交給對局所在 shard 的連線：觀眾，或用續局 token 回到座位的玩家
+struct MatchHandoff {
+    int fd;
+    int match_id;
+    bool resume;
+    uint64_t secret;
+    std::vector<uint8_t> input;   // 原本的 shard 已讀進來、還沒處理的資料（WATCH/RESUME 之後緊接著送的 frame）
+};
+
+// 整行一次輸出，避免多執行緒的 log 交錯
+static void log_line(const std::string& line) {
+    std::cout << line + "\n" << std::flush;
+}
+
+// 一個 reactor 執行緒：擁有自己的 epoll、連線與對局，不和其他 shard 共用遊戲狀態
+class Shard : public AIClient {
+private:
+    int index;
+    int epoll_fd;
+    int wake_fd;                            // eventfd，有新連線或電腦的棋步時喚醒
+    ServerConfig config;
+    AIService* ai;                          // 所有 shard 共用，電腦的棋步由它的 worker 搜尋
+    RecordWriter* records;                  // 所有 shard 共用，NULL 表示不記錄
+    const OpeningBook* book;                // 唯讀共用，沒有開局庫時為空表
+    MatchDirectory* directory;              // 所有 shard 共用
+    SnapshotFile* snapshots;                // 所有 shard 共用，各自只寫自己的格子；NULL 表示不保存
+    std::vector<uint32_t> free_slots;       // 這個 shard 還沒用到的快照格子
+    std::vector<Match*> snapshot_list;      // 本輪有變動、待寫入快照的對局
+    std::mt19937_64 token_rng;              // 產生續局 token
+    unsigned int rand_seed;
+    std::deque<Connection*> waiting;        // 配對佇列，先到先配
+    std::vector<Connection*> closed_list;   // 本輪關閉、待釋放的連線
+    std::vector<Connection*> dirty_list;    // 本輪有新輸出的連線，事件處理完一起送出
+    ObjectPool<Connection> connection_pool;
+    ObjectPool<Match> match_pool;
+    SharedFramePool frame_pool;             // 觀戰用的共用 frame
+    TimerWheel timers;                      // 送名字期限、心跳與每步時限
+    uint64_t now_tick;                      // 本輪 epoll_wait 回來時的 tick
+    std::chrono::steady_clock::time_point start_time;
+
+    std::mutex inbox_mutex;                 // 只保護交接佇列，不在下棋路徑上
+    std::vector<PendingConnection> inbox;
+    std::vector<AIMove> ai_inbox;
+    std::vector<MatchHandoff> handoff_inbox;
+    std::vector<PendingConnection> pending_connections; // 與 inbox 交換用，保留容量避免每次重新配置
+    std::vector<AIMove> pending_ai_moves;
+    std::vector<MatchHandoff> pending_handoffs;
+
+    std::atomic<int> load;                  // 目前持有的連線數
+    std::atomic<int> unpaired;              // 尚未配對的連線數（包含還沒送名字的）
+    std::atomic<uint64_t> moves_played;     // 這個 shard 累計的棋步數（統計用）
+    std::atomic<uint64_t> write_calls;      // 送出資料的系統呼叫次數（統計用）
+
+    ShardMetrics metrics;                   // 只由這個 shard 的執行緒寫入
+    int spectator_total;                    // 目前的觀眾數（統計用）
+    int ai_searches;                        // 已要求、還沒收到棋步的電腦數（統計用）
+#if METRICS_ENABLED
+    // 統計快照：匯出執行緒設定 metrics_requested 並喚醒 shard，shard 在事件迴圈的空檔複製一份
+    std::atomic<bool> metrics_requested;
+    std::mutex metrics_mutex;
+    std::condition_variable metrics_ready;
+    ShardMetrics published_metrics;
+    uint64_t metrics_generation;            // 每複製一次加一，metrics_mutex 保護
+#endif
+
+    // 以 sendmsg（等同 writev，但可加 MSG_NOSIGNAL）送出緩衝區內的所有資料；
+    // socket 滿了（EAGAIN）就留在緩衝區，等 EPOLLOUT 再送。只有連線錯誤時回傳 false
+    bool flush_output(Connection* c) {
+        if (c->watching != NULL || c->draining) return flush_frames(c);
+        while (!c->output.empty()) {
+            struct iovec iov[2];
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = iov;
+            msg.msg_iovlen = c->output.fill_iovec(iov);
+
+            uint64_t start = metrics_now();
+            ssize_t n = sendmsg(c->fd, &msg, MSG_NOSIGNAL);
+            metrics.record_since(LATENCY_SEND, start);
+            write_calls.fetch_add(1, std::memory_order_relaxed);
+            if (n > 0) {
+                metrics.add(COUNTER_BYTES_OUT, n);
+                c->output.consume(n);
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+            return false;
+        }
+        return true;
+    }
+
+    // 觀眾的佇列直接指向共用 frame，一次 sendmsg 送出多則；送完後若曾丟過更新，補一次完整棋盤
+    bool flush_frames(Connection* c) {
+        while (true) {
+            if (c->frames.empty()) {
+                if (!c->resync_pending) return true;
+                c->resync_pending = false;
+                send_board(c, c->watching->game);
+                continue;
+            }
+            struct iovec iov[SPECTATOR_IOV_MAX];
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = iov;
+            msg.msg_iovlen = c->frames.fill_iovec(iov, SPECTATOR_IOV_MAX);
+
+            uint64_t start = metrics_now();
+            ssize_t n = sendmsg(c->fd, &msg, MSG_NOSIGNAL);
+            metrics.record_since(LATENCY_SEND, start);
+            write_calls.fetch_add(1, std::memory_order_relaxed);
+            if (n > 0) {
+                metrics.add(COUNTER_BYTES_OUT, n);
+                c->frames.consume(n, frame_pool);
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+            return false;
+        }
+    }
+
+    // 待送出的 bytes（觀眾不用 output，算佇列中的共用 frame）
+    size_t output_backlog(const Connection* c) const {
+        return (c->watching != NULL || c->draining) ? c->frames.size() : c->output.size();
+    }
+
+    bool has_pending_output(const Connection* c) const {
+        return (c->watching != NULL || c->draining) ? (!c->frames.empty() || c->resync_pending) : !c->output.empty();
+    }
+
+    // 把共用 frame 排進一位觀眾的佇列；佇列滿了代表他跟不上，丟掉還沒送的更新，
+    // 等佇列送完再補一次完整棋盤，不會因為一位慢的觀眾卡住對局
+    void queue_frame(Connection* c, SharedFrame* f) {
+        if (c->closed || c->resync_pending) return;
+        if (!c->frames.push(f)) {
+            c->frames.drop_unsent(frame_pool);
+            c->resync_pending = true;
+            metrics.add(COUNTER_SPECTATOR_DROPS, 1);
+        }
+        mark_dirty(c);
+    }
+
+    // 同一則更新只編碼一次，所有觀眾共用
+    void broadcast(Match* m, SharedFrame* f) {
+        for (Connection* s = m->spectators; s != NULL; s = s->watch_next) {
+            queue_frame(s, f);
+        }
+        if (f->refs == 0) frame_pool.release(f);
+    }
+
+    void mark_dirty(Connection* c) {
+        if (!c->dirty) {
+            c->dirty = true;
+            dirty_list.push_back(c);
+        }
+    }
+
+    // 緩衝區滿了代表對方長時間不讀，不能丟掉部分訊息，只能斷線
+    void append_output(Connection* c, const void* data, size_t length) {
+        if (!c->output.append(data, length)) {
+            c->broken = true;
+            mark_dirty(c);
+        }
+    }
+
+    // 一輪事件處理完，每條有新輸出的連線只做一次系統呼叫，把累積的 frame 一起送出
+    void flush_dirty() {
+        // handle_disconnect 會通知對手，可能在迴圈中再加入新的連線
+        for (size_t i = 0; i < dirty_list.size(); i++) {
+            Connection* c = dirty_list[i];
+            c->dirty = false;
+            if (c->closed) continue;
+            if (c->broken || !flush_output(c)) {
+                handle_disconnect(c);
+                continue;
+            }
+            resume_if_drained(c);
+        }
+        dirty_list.clear();
+    }
+
+    // 輸出降到低水位以下就恢復讀取；edge-triggered 不會再通知已經在 socket 裡的資料，要主動讀
+    void resume_if_drained(Connection* c) {
+        if (c->throttled && output_backlog(c) < OUTPUT_LOW_WATERMARK) {
+            c->throttled = false;
+            handle_readable(c);
+        }
+    }
+
+    void send_text(Connection* c, const char* msg) {
+        if (c->closed || c->is_ai || c->vacant) return;
+        append_output(c, msg, strlen(msg));
+        end_text(c);
+    }
+
+    // 文字訊息的開頭；之後以 append_output 接上內容，再以 end_text 送出
+    bool begin_text(Connection* c, const char* command) {
+        if (c->closed || c->is_ai || c->vacant) return false;
+        append_output(c, command, strlen(command));
+        append_output(c, ":", 1);
+        return true;
+    }
+
+    // 文字協定沒有訊息邊界，舊 client 把一次 recv 當成一則訊息，所以不合併、每則立即送出
+    void end_text(Connection* c) {
+        if (!flush_output(c)) {
+            c->broken = true;
+            mark_dirty(c);
+        }
+    }
+
+    void append_board(Connection* c, const Game& game) {
+        char board[64];
+        game.write_board_state(board);
+        append_output(c, board, sizeof(board));
+    }
+
+    // frame 直接編碼進連線的輸出緩衝區，本輪結束時才送出；觀眾則放進一個只給他的共用 frame
+    void send_frame(Connection* c, uint8_t opcode, const void* payload, size_t length) {
+        if (c->closed || c->is_ai || c->vacant) return;
+        if (c->watching != NULL) {
+            SharedFrame* f = acquire_shared_frame(frame_pool);
+            f->append_frame(opcode, payload, length);
+            queue_frame(c, f);
+            if (f->refs == 0) frame_pool.release(f);
+            return;
+        }
+        if (!c->output.append_frame(opcode, payload, length)) {
+            c->broken = true;
+        }
+        mark_dirty(c);
+    }
+
+    // 回合事件：YOUR_TURN、OPPONENT_TURN、SKIP、OPPONENT_SKIP
+    // 文字協定每次附上完整棋盤；二進位協定的棋盤已由 MOVE_PLAYED 增量更新
+    void send_turn_event(Connection* c, uint8_t opcode, const Game& game) {
+        if (c->protocol == PROTO_BINARY) {
+            send_frame(c, opcode, NULL, 0);
+        } else {
+            if (!begin_text(c, text_command(opcode))) return;
+            append_board(c, game);
+            end_text(c);
+        }
+    }
+
+    // 二進位 client 直接收到合法位置，不必自己計算提示
+    void send_your_turn(Connection* c, const Game& game, uint64_t legal) {
+        if (c->protocol == PROTO_BINARY) {
+            uint8_t payload[LEGAL_MASK_PAYLOAD_SIZE];
+            put_u64(payload, legal);
+            send_frame(c, OP_YOUR_TURN, payload, sizeof(payload));
+        } else {
+            send_turn_event(c, OP_YOUR_TURN, game);
+        }
+    }
+
+    void send_invalid(Connection* c, uint8_t reason) {
+        if (c->protocol == PROTO_BINARY) {
+            send_frame(c, OP_INVALID, &reason, 1);
+        } else if (reason == INVALID_FORMAT) {
+            send_text(c, "INVALID:Invalid position format");
+        } else {
+            send_text(c, "INVALID:Invalid move");
+        }
+    }
+
+    void send_board(Connection* c, const Game& game) {
+        uint8_t board[BOARD_PAYLOAD_SIZE];
+        encode_board(board, game.get_black_board(), game.get_white_board());
+        send_frame(c, OP_BOARD, board, sizeof(board));
+    }
+
+    void send_opponent_disconnect(Connection* c) {
+        if (c->protocol == PROTO_BINARY) {
+            send_frame(c, OP_OPPONENT_DISCONNECT, NULL, 0);
+        } else {
+            send_text(c, "OPPONENT_DISCONNECT:");
+        }
+    }
+
+    Connection* new_connection(int fd) {
+        Connection* c = connection_pool.acquire();
+        c->fd = fd;
+        c->name[0] = '\0';
+        c->decoder.reset();
+        c->output.reset();
+        c->dirty = false;
+        c->throttled = false;
+        c->broken = false;
+        c->timer.kind = TIMER_CONNECTION;
+        c->timer.owner = c;
+        c->last_heard = now_tick;
+        c->protocol = PROTO_UNKNOWN;
+        c->named = false;
+        c->closed = false;
+        c->is_ai = false;
+        c->vacant = false;
+        c->match = NULL;
+        c->seat = -1;
+        c->watching = NULL;
+        c->watch_prev = NULL;
+        c->watch_next = NULL;
+        c->frames.reset();
+        c->resync_pending = false;
+        c->draining = false;
+        return c;
+    }
+
+    bool register_connection(Connection* c) {
+        struct epoll_event ev;
+        // EPOLLOUT 也用 edge-triggered：只有 socket 從滿變成可寫時才通知，平常不會多出事件
+        // EPOLLRDHUP：對方關閉連線時直接由事件得知，不必另外探測
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.ptr = c;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, c->fd, &ev) < 0) {
+            std::cerr << "epoll_ctl failed: " << strerror(errno) << "\n";
+            close(c->fd);
+            connection_pool.release(c);
+            load--;
+            return false;
+        }
+        return true;
+    }
+
+    Connection* new_ai_player() {
+        Connection* c = new_connection(-1);
+        strcpy(c->name, AI_NAME);
+        c->named = true;
+        c->is_ai = true;
+        return c;
+    }
+
+    void drain_inbox() {
+        uint64_t value;
+        while (read(wake_fd, &value, sizeof(value)) > 0) {
+        }
+
+        std::vector<PendingConnection>& fds = pending_connections;
+        std::vector<AIMove>& ai_moves = pending_ai_moves;
+        std::vector<MatchHandoff>& handoffs = pending_handoffs;
+        {
+            std::lock_guard<std::mutex> lock(inbox_mutex);
+            fds.swap(inbox);
+            ai_moves.swap(ai_inbox);
+            handoffs.swap(handoff_inbox);
+        }
+
+        for (size_t i = 0; i < ai_moves.size(); i++) {
+            // 對局可能已因斷線結束
+            Match* m = ai_moves[i].match;
+            ai_searches--;
+            if (m->id != ai_moves[i].match_id) continue;
+            if (!m->players[m->current_turn]->is_ai || ai_moves[i].square < 0) continue;
+            handle_move(m, ai_moves[i].square / 8, ai_moves[i].square % 8);
+        }
+
+        for (size_t i = 0; i < fds.size(); i++) {
+            Connection* c = new_connection(fds[i].fd);
+            if (!register_connection(c)) {
+                unpaired--;
+                continue;
+            }
+            metrics.record_since(LATENCY_ACCEPT, fds[i].accepted_at);
+            metrics.add(COUNTER_CONNECTIONS, 1);
+            timers.schedule(&c->timer, now_tick + seconds_to_ticks(HELLO_TIMEOUT_SECONDS));
+        }
+
+        // 其他 shard 轉來的觀眾與續局的玩家：對局在這裡，之後都由這個 shard 處理
+        for (size_t i = 0; i < handoffs.size(); i++) {
+            Connection* c = new_connection(handoffs[i].fd);
+            c->protocol = PROTO_BINARY;
+            if (!register_connection(c)) continue;
+
+            Shard* shard;
+            Match* m;
+            bool found = directory->find(handoffs[i].match_id, shard, m) && shard == this;
+            if (handoffs[i].resume) {
+                if (!found || !resume_seat(c, m, handoffs[i].secret)) {
+                    send_frame(c, OP_RESUME_FAILED, NULL, 0);
+                    close_connection(c);
+                }
+            } else if (found) {
+                attach_spectator(c, m);
+            } else {
+                // 交接期間對局已經結束
+                send_frame(c, OP_WATCH_FAILED, NULL, 0);
+                close_connection(c);
+            }
+            // 接著處理跟在 WATCH/RESUME 後面、原本的 shard 已經讀進來的 frame
+            if (!c->closed && !handoffs[i].input.empty()) {
+                c->decoder.feed(handoffs[i].input.data(), handoffs[i].input.size());
+                process_input(c);
+            }
+        }
+        fds.clear();
+        ai_moves.clear();
+        handoffs.clear();
+    }
+
+    // edge-triggered：一次把資料讀到 EAGAIN 為止，直接讀進連線的解碼緩衝區
+    void handle_readable(Connection* c) {
+        // 恢復讀取時，先處理上次暫停時留在解碼緩衝區的 frame
+        if (c->throttled) {
+            c->throttled = false;
+            if (c->decoder.available() > 0) process_input(c);
+        }
+        while (!c->closed) {
+            // 對方不讀取，送不出去的資料太多：先不處理他的請求（例如一直送 RESYNC）
+            if (output_backlog(c) > OUTPUT_HIGH_WATERMARK) {
+                c->throttled = true;
+                return;
+            }
+            ssize_t valread = read(c->fd, c->decoder.write_ptr(), c->decoder.write_space());
+            if (valread > 0) {
+                metrics.add(COUNTER_BYTES_IN, valread);
+                c->last_heard = now_tick;
+                c->decoder.commit(valread);
+                process_input(c);
+                continue;
+            }
+            if (valread < 0 && errno == EINTR) continue;
+            if (valread < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+
+            // valread == 0 或讀取錯誤：連線中斷
+            handle_disconnect(c);
+            return;
+        }
+    }
+
+    void process_input(Connection* c) {
+        if (c->protocol == PROTO_UNKNOWN) {
+            const uint8_t* p = c->decoder.data();
+            if (p[0] != 0x00) {
+                c->protocol = PROTO_TEXT;
+            } else if (c->decoder.available() < PREAMBLE_SIZE) {
+                return;
+            } else if (p[1] == 'R' && p[2] == 'V' && p[3] == PROTOCOL_VERSION) {
+                c->protocol = PROTO_BINARY;
+                c->decoder.consume(PREAMBLE_SIZE);
+            } else {
+                handle_disconnect(c);
+                return;
+            }
+        }
+
+        if (c->protocol == PROTO_TEXT) {
+            // 文字協定沒有分隔，沿用舊行為：一次 read 視為一則訊息
+            // 直接在解碼緩衝區上處理，處理完才 consume
+            const char* msg = (const char*)c->decoder.data();
+            size_t length = c->decoder.available();
+            // 容許 telnet/nc 送來的換行
+            while (length > 0 && (msg[length - 1] == '\n' || msg[length - 1] == '\r')) {
+                length--;
+            }
+            handle_text_message(c, msg, length);
+            c->decoder.consume(c->decoder.available());
+            return;
+        }
+
+        // 輸出超過高水位就停下，剩下的 frame 留在解碼緩衝區，等送出後再處理
+        Frame f;
+        while (!c->closed && output_backlog(c) <= OUTPUT_HIGH_WATERMARK) {
+            uint64_t start = metrics_now();
+            if (!c->decoder.next(f)) break;
+            metrics.record_since(LATENCY_DECODE, start);
+            metrics.add(COUNTER_FRAMES_IN, 1);
+            handle_frame(c, f);
+        }
+        if (c->decoder.is_malformed()) {
+            handle_disconnect(c);
+        }
+    }
+
+    void handle_text_message(Connection* c, const char* msg, size_t length) {
+        if (!c->named) {
+            handle_hello(c, msg, length, false);
+            return;
+        }
+
+        Match* m = c->match;
+        if (m == NULL || m->current_turn != c->seat) {
+            return;  // 不是他的回合，忽略
+        }
+
+        int row, col;
+        if (!m->game.parse_move(msg, length, row, col)) {
+            send_invalid(c, INVALID_FORMAT);
+            return;
+        }
+        handle_move(m, row, col);
+    }
+
+    void handle_frame(Connection* c, const Frame& f) {
+        if (c->draining) return;   // 看的對局已結束，只等輸出送完
+
+        if (f.opcode == OP_HELLO || f.opcode == OP_HELLO_PRACTICE) {
+            if (!c->named) {
+                handle_hello(c, (const char*)f.payload, f.length, f.opcode == OP_HELLO_PRACTICE);
+            }
+            return;
+        }
+
+        if (f.opcode == OP_WATCH) {
+            if (!c->named) {
+                handle_watch(c, f.length >= 4 ? (int)get_u32(f.payload) : 0);
+            }
+            return;
+        }
+
+        if (f.opcode == OP_RESUME) {
+            if (!c->named && f.length == RESUME_TOKEN_SIZE) {
+                handle_resume(c, (int)get_u32(f.payload), get_u64(f.payload + 4));
+            }
+            return;
+        }
+
+        if (f.opcode == OP_RESYNC && c->watching != NULL) {
+            send_board(c, c->watching->game);
+            return;
+        }
+
+        if (f.opcode == OP_MOVE) {
+            Match* m = c->match;
+            if (m == NULL || m->current_turn != c->seat) {
+                return;  // 不是他的回合，忽略
+            }
+            if (f.length != 1 || f.payload[0] >= 64) {
+                send_invalid(c, INVALID_FORMAT);
+                return;
+            }
+            handle_move(m, f.payload[0] / 8, f.payload[0] % 8);
+            return;
+        }
+
+        if (f.opcode == OP_RESYNC && c->match != NULL) {
+            send_board(c, c->match->game);
+        }
+    }
+
+    // 觀眾：對局在這個 shard 就直接加入，否則把 socket 交給對局所在的 shard，
+    // 之後每則更新都在同一個執行緒編碼與送出，共用 frame 不必加鎖
+    void handle_watch(Connection* c, int match_id) {
+        Shard* shard;
+        Match* m;
+        unpaired--;   // 觀眾不參加配對
+        if (!directory->find(match_id, shard, m)) {
+            send_frame(c, OP_WATCH_FAILED, NULL, 0);
+            close_connection(c);
+            return;
+        }
+        if (shard == this) {
+            attach_spectator(c, m);
+            return;
+        }
+        migrate(c, shard, match_id > 0 ? match_id : m->id, false, 0);
+    }
+
+    // 從 epoll 移除但不關閉 fd，交給對局所在的 shard；連線物件在本輪結束時放回池中
+    void migrate(Connection* c, Shard* target, int match_id, bool resume, uint64_t secret) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+        timers.cancel(&c->timer);
+        c->closed = true;
+        closed_list.push_back(c);
+        load--;
+        target->adopt_connection(c->fd, match_id, resume, secret, c->decoder.data(), c->decoder.available());
+    }
+
+    // 續局：server 重新啟動後，玩家用 token 回到還原的對局中自己的座位
+    void handle_resume(Connection* c, int match_id, uint64_t secret) {
+        Shard* shard;
+        Match* m;
+        unpaired--;   // 不參加配對
+        if (match_id == 0 || !directory->find(match_id, shard, m)) {
+            send_frame(c, OP_RESUME_FAILED, NULL, 0);
+            close_connection(c);
+            return;
+        }
+        if (shard != this) {
+            migrate(c, shard, match_id, true, secret);
+            return;
+        }
+        if (!resume_seat(c, m, secret)) {
+            send_frame(c, OP_RESUME_FAILED, NULL, 0);
+            close_connection(c);
+        }
+    }
+
+    // 座位還空著且 token 正確時，連線接手這個座位，送出開局、完整棋盤與目前的回合
+    bool resume_seat(Connection* c, Match* m, uint64_t secret) {
+        int seat = -1;
+        for (int i = 0; i < 2; i++) {
+            if (m->players[i]->vacant && m->secrets[i] == secret) seat = i;
+        }
+        if (seat < 0) return false;
+
+        Connection* placeholder = m->players[seat];
+        memcpy(c->name, placeholder->name, sizeof(c->name));
+        c->named = true;
+        c->match = m;
+        c->seat = seat;
+        m->players[seat] = c;
+        placeholder->match = NULL;
+        close_connection(placeholder);
+
+        if (config.heartbeat_seconds > 0) {
+            timers.schedule(&c->timer, c->last_heard + seconds_to_ticks(config.heartbeat_seconds));
+        } else {
+            timers.cancel(&c->timer);
+        }
+        log_line(std::string(c->name) + " resumed match #" + std::to_string(m->id));
+
+        const char* opponent_name = m->players[1 - seat]->name;
+        size_t name_length = strlen(opponent_name);
+        uint8_t payload[1 + MAX_NAME_LENGTH];
+        payload[0] = m->pieces[seat];
+        memcpy(payload + 1, opponent_name, name_length);
+        send_frame(c, OP_START, payload, 1 + name_length);
+        send_board(c, m->game);
+        if (m->current_turn == seat) {
+            send_your_turn(c, m->game, m->legal);
+        } else {
+            send_turn_event(c, OP_OPPONENT_TURN, m->game);
+        }
+        return true;
+    }
+
+    void attach_spectator(Connection* c, Match* m) {
+        strcpy(c->name, SPECTATOR_NAME);
+        c->named = true;
+        c->watching = m;
+        c->watch_prev = NULL;
+        c->watch_next = m->spectators;
+        if (m->spectators != NULL) m->spectators->watch_prev = c;
+        m->spectators = c;
+        m->spectator_count++;
+        spectator_total++;
+        if (config.heartbeat_seconds > 0) {
+            timers.schedule(&c->timer, c->last_heard + seconds_to_ticks(config.heartbeat_seconds));
+        } else {
+            timers.cancel(&c->timer);
+        }
+
+        uint8_t payload[4 + BOARD_PAYLOAD_SIZE + 2 * (1 + MAX_NAME_LENGTH)];
+        int black_seat = (m->pieces[0] == 'X') ? 0 : 1;
+        put_u32(payload, m->id);
+        encode_board(payload + 4, m->game.get_black_board(), m->game.get_white_board());
+        size_t length = 4 + BOARD_PAYLOAD_SIZE;
+        for (int i = 0; i < 2; i++) {
+            const char* name = m->players[i == 0 ? black_seat : 1 - black_seat]->name;
+            size_t name_length = strlen(name);
+            payload[length++] = (uint8_t)name_length;
+            memcpy(payload + length, name, name_length);
+            length += name_length;
+        }
+        send_frame(c, OP_WATCH_START, payload, length);
+
+        if (config.verbose) {
+            std::ostringstream line;
+            line << "[#" << m->id << "] spectator joined (" << m->spectator_count << " watching)";
+            log_line(line.str());
+        }
+    }
+
+    void detach_spectator(Connection* c) {
+        Match* m = c->watching;
+        if (c->watch_prev != NULL) c->watch_prev->watch_next = c->watch_next;
+        else m->spectators = c->watch_next;
+        if (c->watch_next != NULL) c->watch_next->watch_prev = c->watch_prev;
+        m->spectator_count--;
+        spectator_total--;
+        c->watching = NULL;
+        c->watch_prev = NULL;
+        c->watch_next = NULL;
+    }
+
+    void handle_hello(Connection* c, const char* name, size_t length, bool practice) {
+        if (length > MAX_NAME_LENGTH) length = MAX_NAME_LENGTH;
+        memcpy(c->name, name, length);
+        c->name[length] = '\0';
+        c->named = true;
+        log_line(std::string("Player connected: ") + c->name);
+        // 名字已收到，連線計時器改作心跳；文字協定無法插入 PING，不檢查
+        if (c->protocol == PROTO_BINARY && config.heartbeat_seconds > 0) {
+            timers.schedule(&c->timer, c->last_heard + seconds_to_ticks(config.heartbeat_seconds));
+        } else {
+            timers.cancel(&c->timer);
+        }
+        if (practice) {
+            start_match(c, new_ai_player(), true);  // 練習模式：直接和電腦對戰
+        } else {
+            enqueue_player(c);
+        }
+    }
+
+    // 配對：佇列中有人等待就開新對局，否則排隊
+    void enqueue_player(Connection* c) {
+        if (waiting.empty()) {
+            c->wait_since = std::chrono::steady_clock::now();
+            waiting.push_back(c);
+            if (c->protocol == PROTO_BINARY) {
+                send_frame(c, OP_WAIT, NULL, 0);
+            } else {
+                send_text(c, "WAIT:Waiting for another player...");
+            }
+            return;
+        }
+
+        Connection* first = waiting.front();
+        waiting.pop_front();
+        start_match(first, c, false);
+    }
+
+    // 新對局與還原的對局共用的初始化
+    Match* new_match(int id, Connection* a, Connection* b, bool practice) {
+        Match* m = match_pool.acquire();
+        m->id = id;
+        m->game = Game();
+        m->players[0] = a;
+        m->players[1] = b;
+        a->match = m;
+        a->seat = 0;
+        b->match = m;
+        b->seat = 1;
+        m->moves_played = 0;
+        m->legal = 0;
+        m->turn_timer.kind = TIMER_TURN;
+        m->turn_timer.owner = m;
+        m->end_reason = RECORD_END_NORMAL;
+        m->forfeit_seat = -1;
+        m->practice = practice;
+        m->spectators = NULL;
+        m->spectator_count = 0;
+        m->secrets[0] = 0;
+        m->secrets[1] = 0;
+        m->snapshot_slot = -1;
+        m->snapshot_dirty = false;
+        directory->add(m->id, this, m);
+        // 文字協定收不到 RESUME_TOKEN，還原後也回不來，這種對局不保存
+        bool resumable = true;
+        for (int i = 0; i < 2; i++) {
+            if (!m->players[i]->is_ai && m->players[i]->protocol != PROTO_BINARY) resumable = false;
+        }
+        if (snapshots != NULL && resumable) {
+            // token 的秘密值不能是 0，0 留給「沒有 token」
+            for (int i = 0; i < 2; i++) {
+                do {
+                    m->secrets[i] = token_rng();
+                } while (m->secrets[i] == 0);
+            }
+            if (!free_slots.empty()) {
+                m->snapshot_slot = free_slots.back();
+                free_slots.pop_back();
+            }
+        }
+        return m;
+    }
+
+    void start_match(Connection* a, Connection* b, bool practice) {
+        Match* m = new_match(++next_match_id, a, b, practice);
+        metrics.add(COUNTER_MATCHES, 1);
+        unpaired -= a->is_ai ? 0 : 1;
+        unpaired -= b->is_ai ? 0 : 1;
+
+        m->current_turn = rand_r(&rand_seed) % 2;
+        m->pieces[m->current_turn] = 'X';
+        m->pieces[1 - m->current_turn] = 'O';
+
+        for (int i = 0; i < 2; i++) {
+            Connection* c = m->players[i];
+            const char* opponent_name = m->players[1 - i]->name;
+            size_t name_length = strlen(opponent_name);
+            if (c->protocol == PROTO_BINARY) {
+                uint8_t payload[1 + MAX_NAME_LENGTH];
+                payload[0] = m->pieces[i];
+                memcpy(payload + 1, opponent_name, name_length);
+                send_frame(c, OP_START, payload, 1 + name_length);
+                if (m->snapshot_slot >= 0) {
+                    uint8_t token[RESUME_TOKEN_SIZE];
+                    put_u32(token, m->id);
+                    put_u64(token + 4, m->secrets[i]);
+                    send_frame(c, OP_RESUME_TOKEN, token, sizeof(token));
+                }
+            } else if (begin_text(c, "START")) {
+                char piece[2] = {':', m->pieces[i]};
+                append_output(c, opponent_name, name_length);
+                append_output(c, piece, sizeof(piece));
+                end_text(c);
+            }
+        }
+        mark_snapshot(m);
+
+        std::ostringstream line;
+        line << "[#" << m->id << "] " << a->name << " vs " << b->name << ", "
+             << m->players[m->current_turn]->name << " (X) goes first!";
+        log_line(line.str());
+
+        begin_turn(m);
+    }
+
+    // 回合開始：處理跳過與結束，否則通知雙方輪到誰
+    void begin_turn(Match* m) {
+        int current = m->current_turn;
+        int opponent = 1 - current;
+
+        // 合法位置只在回合開始時算一次，pass 與終局判斷、驗證棋步都用這個 mask
+        uint64_t legal = m->game.get_valid_moves(m->pieces[current]);
+        if (legal == 0) {
+            legal = m->game.get_valid_moves(m->pieces[opponent]);
+            if (legal == 0) {
+                std::string result = m->game.get_result();
+                for (int i = 0; i < 2; i++) {
+                    send_end(m->players[i], m->game);
+                }
+
+                std::ostringstream line;
+                line << "[#" << m->id << "] Game over: " << result;
+                log_line(line.str());
+                finish_match(m);
+                return;
+            }
+
+            if (config.verbose) {
+                std::ostringstream line;
+                line << "[#" << m->id << "] " << m->players[current]->name
+                     << " has no valid moves, skipping...";
+                log_line(line.str());
+            }
+            send_turn_event(m->players[current], OP_SKIP, m->game);
+            send_turn_event(m->players[opponent], OP_OPPONENT_SKIP, m->game);
+            m->current_turn = opponent;
+            std::swap(current, opponent);
+        }
+
+        m->legal = legal;
+        if (!m->players[current]->is_ai && config.turn_seconds > 0) {
+            timers.schedule(&m->turn_timer, now_tick + seconds_to_ticks(config.turn_seconds));
+        } else {
+            timers.cancel(&m->turn_timer);
+        }
+        send_your_turn(m->players[current], m->game, legal);
+        send_turn_event(m->players[opponent], OP_OPPONENT_TURN, m->game);
+
+        if (m->players[current]->is_ai) {
+            request_ai_move(m);
+        }
+    }
+
+    // 電腦在另一個執行緒思考，算完交回這個 shard，不會卡住其他對局
+    void request_ai_move(Match* m) {
+        ai_searches++;   // 開局庫的棋步也經過 ai_inbox，收到時才減回
+        Game position = m->game;
+        char piece = m->pieces[m->current_turn];
+        int match_id = m->id;
+
+        // 開局庫有這個局面就直接下，不必排隊搜尋
+        int book_move, book_score;
+        if (book->probe(position, piece, book_move, book_score)) {
+            if (config.verbose) {
+                std::stringstream line;
+                line << "Match " << match_id << ": " << piece << " book move "
+                     << position.format_move(book_move / 8, book_move % 8) << " (score " << book_score << ")";
+                log_line(line.str());
+            }
+            post_ai_move(m, match_id, book_move);
+            return;
+        }
+
+        // 交給共用的 AIService 排隊搜尋，不在 reactor 執行緒等待
+        ai->submit(position, piece, m->practice ? AI_PRIORITY_PRACTICE : AI_PRIORITY_RATED, config.ai_time_ms,
+                   this, m, match_id);
+    }
+
+    void post_ai_move(Match* match, int match_id, int square) {
+        AIMove move;
+        move.match = match;
+        move.match_id = match_id;
+        move.square = square;
+        {
+            std::lock_guard<std::mutex> lock(inbox_mutex);
+            ai_inbox.push_back(move);
+        }
+        wake();
+    }
+
+public:
+    // 由 AIService 的 worker 呼叫（命中快取時在本 shard 的執行緒）：context 是對局，tag 是當時的對局編號。
+    // 對局可能已經結束，這裡只交回 ai_inbox，由 shard 自己比對編號
+    void ai_move_ready(void* context, int tag, const AIResult& result) {
+        if (config.verbose && result.solved && !result.cached) {
+            std::stringstream line;
+            line << "Match " << tag << ": solved, final margin " << result.score << " (" << result.seconds << "s)";
+            log_line(line.str());
+        }
+        post_ai_move((Match*)context, tag, result.move);
+    }
 
-class Server {
 private:
-    int server_fd;
-    int client_sockets[2];
-    std::string player_names[2];
-    char player_pieces[2];
-    Game* game;
-    int current_turn;
-    
-    void send_message(int client_idx, const std::string& msg) {
-        send(client_sockets[client_idx], msg.c_str(), msg.length(), 0);
-    }
-    
-    // 檢查客戶端是否斷線（非阻塞檢查）
-    bool check_client_connected(int client_idx) {
-        fd_set read_fds;
-        struct timeval tv;
-        FD_ZERO(&read_fds);
-        FD_SET(client_sockets[client_idx], &read_fds);
-        
-        tv.tv_sec = 0;
-        tv.tv_usec = 0;
-        
-        int result = select(client_sockets[client_idx] + 1, &read_fds, NULL, NULL, &tv);
-        
-        if (result > 0) {
-            // 有資料可讀，檢查是否是斷線
-            char buffer[1];
-            int n = recv(client_sockets[client_idx], buffer, 1, MSG_PEEK | MSG_DONTWAIT);
-            if (n == 0) {
-                // 連接已關閉
+    void wake() {
+        uint64_t one = 1;
+        if (write(wake_fd, &one, sizeof(one)) < 0) {
+            std::cerr << "Shard " << index << ": wake failed\n";
+        }
+    }
+
+    static uint64_t seconds_to_ticks(int seconds) {
+        return (uint64_t)seconds * 1000 / TIMER_TICK_MS;
+    }
+
+    uint64_t current_tick() const {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::steady_clock::now() - start_time).count() / TIMER_TICK_MS;
+    }
+
+    void handle_timer(Timer* t) {
+        if (t->kind == TIMER_TURN) {
+            // 這一步超過時限：輪到的玩家視同斷線，對手獲勝，不讓他一直佔住對局
+            Match* m = (Match*)t->owner;
+            Connection* player = m->players[m->current_turn];
+            std::ostringstream line;
+            line << "[#" << m->id << "] " << player->name << " ran out of time";
+            log_line(line.str());
+            m->end_reason = RECORD_END_TIMEOUT;
+            handle_disconnect(player);
+            return;
+        }
+
+        Connection* c = (Connection*)t->owner;
+        if (c->draining) {
+            close_connection(c);   // 觀眾一直不讀，END 送不完就算了
+            return;
+        }
+        if (c->vacant) {
+            log_line(std::string(c->name) + " did not come back");
+            handle_disconnect(c);
+            return;
+        }
+        if (!c->named) {
+            log_line("Connection closed: no name received");
+            handle_disconnect(c);
+            return;
+        }
+
+        // 心跳：最後一次收到資料後過了一個間隔就送 PING，過了兩個間隔仍沒有回應就斷線。
+        // 輪到他下棋時 client 可能正在等玩家輸入，交給每步時限處理
+        uint64_t interval = seconds_to_ticks(config.heartbeat_seconds);
+        uint64_t silent = now_tick - c->last_heard;
+        bool thinking = c->match != NULL && c->match->current_turn == c->seat;
+        if (silent >= 2 * interval && !thinking) {
+            log_line(std::string(c->name) + " stopped responding");
+            handle_disconnect(c);
+        } else if (silent >= interval) {
+            send_frame(c, OP_PING, NULL, 0);
+            timers.schedule(&c->timer, std::max(c->last_heard + 2 * interval, now_tick + interval));
+        } else {
+            timers.schedule(&c->timer, c->last_heard + interval);
+        }
+    }
+
+    // 等太久的玩家由電腦補位
+    void fill_waiting_with_ai() {
+        if (config.ai_fill_seconds <= 0) return;
+
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        while (!waiting.empty() &&
+               now - waiting.front()->wait_since >= std::chrono::seconds(config.ai_fill_seconds)) {
+            Connection* c = waiting.front();
+            waiting.pop_front();
+            start_match(c, new_ai_player(), false);
+        }
+    }
+
+    void send_end(Connection* c, const Game& game) {
+        if (c->protocol == PROTO_BINARY) {
+            uint8_t payload[1 + BOARD_PAYLOAD_SIZE];
+            int black = game.get_black_count();
+            int white = game.get_white_count();
+            payload[0] = black > white ? RESULT_X_WINS : (white > black ? RESULT_O_WINS : RESULT_DRAW);
+            encode_board(payload + 1, game.get_black_board(), game.get_white_board());
+            send_frame(c, OP_END, payload, sizeof(payload));
+        } else if (begin_text(c, "END")) {
+            std::string result = game.get_result();  // 短字串，不會配置記憶體
+            append_output(c, result.data(), result.size());
+            append_output(c, ":", 1);
+            append_board(c, game);
+            end_text(c);
+        }
+    }
+
+    void handle_move(Match* m, int row, int col) {
+        Connection* player = m->players[m->current_turn];
+        char piece = m->pieces[m->current_turn];
+        uint64_t opponent_before = (piece == 'X') ? m->game.get_white_board() : m->game.get_black_board();
+
+        uint64_t start = metrics_now();
+        bool legal = (m->legal & (1ULL << (row * 8 + col))) != 0;
+        metrics.record_since(LATENCY_VALIDATE, start);
+        if (!legal) {
+            metrics.add(COUNTER_INVALID_MOVES, 1);
+            send_invalid(player, INVALID_MOVE);
+            return;
+        }
+        start = metrics_now();
+        m->game.make_move(row, col, piece);
+        metrics.record_since(LATENCY_MAKE_MOVE, start);
+        if (m->moves_played < RECORD_MAX_MOVES) {
+            m->moves[m->moves_played] = row * 8 + col;
+        }
+        m->moves_played++;
+        moves_played.fetch_add(1, std::memory_order_relaxed);
+        metrics.add(COUNTER_MOVES, 1);
+        mark_snapshot(m);
+
+        if (config.verbose) {
+            std::ostringstream line;
+            line << "[#" << m->id << "] " << player->name << " (" << piece << ") played "
+                 << m->game.format_move(row, col);
+            log_line(line.str());
+        }
+
+        // 發送 OK 給當前玩家
+        start = metrics_now();
+        if (player->protocol == PROTO_BINARY) {
+            uint8_t square = row * 8 + col;
+            send_frame(player, OP_MOVE_OK, &square, 1);
+        } else if (begin_text(player, "MOVE_OK")) {
+            char move[2] = {(char)('a' + col), (char)('0' + (8 - row))};
+            append_output(player, move, sizeof(move));
+            end_text(player);
+        }
+
+        // 二進位 client 只收這一步與翻轉的棋子，定期附上 checksum 供比對
+        uint64_t opponent_after = (piece == 'X') ? m->game.get_white_board() : m->game.get_black_board();
+        uint8_t delta[MOVE_PLAYED_PAYLOAD_SIZE];
+        delta[0] = row * 8 + col;
+        delta[1] = piece;
+        put_u64(delta + 2, opponent_before & ~opponent_after);
+
+        uint8_t checksum[4];
+        bool send_checksum = (m->moves_played % CHECKSUM_INTERVAL == 0);
+        if (send_checksum) {
+            put_u32(checksum, board_checksum(m->game.get_black_board(), m->game.get_white_board()));
+        }
+
+        for (int i = 0; i < 2; i++) {
+            if (m->players[i]->protocol != PROTO_BINARY) continue;
+            send_frame(m->players[i], OP_MOVE_PLAYED, delta, sizeof(delta));
+            if (send_checksum) {
+                send_frame(m->players[i], OP_CHECKSUM, checksum, sizeof(checksum));
+            }
+        }
+        if (m->spectators != NULL) {
+            SharedFrame* f = acquire_shared_frame(frame_pool);
+            f->append_frame(OP_MOVE_PLAYED, delta, sizeof(delta));
+            if (send_checksum) {
+                f->append_frame(OP_CHECKSUM, checksum, sizeof(checksum));
+            }
+            broadcast(m, f);
+        }
+        metrics.record_since(LATENCY_ENCODE, start);
+
+        m->current_turn = 1 - m->current_turn;
+        begin_turn(m);
+    }
+
+    void handle_disconnect(Connection* c) {
+        if (c->closed) return;
+
+        if (c->watching != NULL || c->draining) {
+            close_connection(c);
+            return;
+        }
+
+        if (c->named) {
+            log_line(std::string(c->name) + " disconnected");
+        }
+
+        Match* m = c->match;
+        if (m != NULL) {
+            Connection* other = m->players[1 - c->seat];
+            if (m->end_reason == RECORD_END_NORMAL) m->end_reason = RECORD_END_DISCONNECT;
+            m->forfeit_seat = c->seat;
+            send_opponent_disconnect(other);
+            finish_match(m);
+            return;
+        }
+
+        for (std::deque<Connection*>::iterator it = waiting.begin(); it != waiting.end(); ++it) {
+            if (*it == c) {
+                waiting.erase(it);
+                break;
+            }
+        }
+        unpaired--;
+        close_connection(c);
+    }
+
+    // 對局結束：兩位玩家與所有觀眾一起斷線，與單場伺服器結束時的行為相同
+    void finish_match(Match* m) {
+        write_record(m);
+        directory->remove(m->id);
+        if (m->snapshot_slot >= 0) {
+            snapshots->clear(m->snapshot_slot);
+            free_slots.push_back(m->snapshot_slot);
+            m->snapshot_slot = -1;
+        }
+        end_spectators(m);
+        for (int i = 0; i < 2; i++) {
+            m->players[i]->match = NULL;
+            close_connection(m->players[i]);
+        }
+        timers.cancel(&m->turn_timer);
+        m->id = 0;
+        match_pool.release(m);
+    }
+
+    // 斷線或超時的一方判負，否則依子數
+    static uint8_t match_result(const Match* m) {
+        int black_seat = (m->pieces[0] == 'X') ? 0 : 1;
+        if (m->forfeit_seat >= 0) {
+            return (m->forfeit_seat == black_seat) ? RESULT_O_WINS : RESULT_X_WINS;
+        }
+        int black = m->game.get_black_count();
+        int white = m->game.get_white_count();
+        return black > white ? RESULT_X_WINS : (white > black ? RESULT_O_WINS : RESULT_DRAW);
+    }
+
+    // 觀眾收到結果與最後的棋盤後斷線；END 一定要送到，跟不上的觀眾改送 END 取代補發的棋盤。
+    // 送不完的觀眾離開對局、進入 draining，等 EPOLLOUT 把佇列送完才關閉，最多等 DRAIN_TIMEOUT_SECONDS
+    void end_spectators(Match* m) {
+        if (m->spectators == NULL) return;
+
+        uint8_t payload[1 + BOARD_PAYLOAD_SIZE];
+        payload[0] = match_result(m);
+        encode_board(payload + 1, m->game.get_black_board(), m->game.get_white_board());
+        SharedFrame* f = acquire_shared_frame(frame_pool);
+        f->append_frame(OP_END, payload, sizeof(payload));
+
+        f->refs++;   // 關閉觀眾時會釋放參考，先持有一份
+        while (m->spectators != NULL) {
+            Connection* s = m->spectators;
+            if (s->resync_pending || !s->frames.push(f)) {
+                s->frames.drop_unsent(frame_pool);
+                s->resync_pending = false;
+                s->frames.push(f);
+            }
+            detach_spectator(s);
+            s->draining = true;
+            if (!flush_frames(s) || s->frames.empty()) {
+                close_connection(s);
+            } else {
+                timers.schedule(&s->timer, now_tick + seconds_to_ticks(DRAIN_TIMEOUT_SECONDS));
+            }
+        }
+        release_shared_frame(frame_pool, f);
+    }
+
+    // 交給背景執行緒寫檔，這裡只編碼與複製
+    void write_record(Match* m) {
+        if (records == NULL) return;
+
+        int black_seat = (m->pieces[0] == 'X') ? 0 : 1;
+        uint8_t result = match_result(m);
+        uint8_t record[RECORD_MAX_SIZE];
+        size_t length = encode_record(record, time(NULL), result, m->end_reason,
+                                      m->players[black_seat]->name, m->players[1 - black_seat]->name,
+                                      m->moves, std::min(m->moves_played, RECORD_MAX_MOVES));
+        records->append(record, length);
+    }
+
+    void close_connection(Connection* c) {
+        if (c->closed) return;
+        c->closed = true;
+        timers.cancel(&c->timer);
+        if (!c->is_ai && !c->vacant) {
+            // 盡量送出還在緩衝區的訊息（例如 END、OPPONENT_DISCONNECT）再關閉
+            c->resync_pending = false;
+            flush_output(c);
+            close(c->fd);  // close 會自動從 epoll 移除
+            load--;
+        }
+        if (c->watching != NULL || c->draining) {
+            c->frames.clear(frame_pool);
+            if (c->watching != NULL) detach_spectator(c);
+        }
+        closed_list.push_back(c);
+    }
+
+    void mark_snapshot(Match* m) {
+        if (m->snapshot_slot >= 0 && !m->snapshot_dirty) {
+            m->snapshot_dirty = true;
+            snapshot_list.push_back(m);
+        }
+    }
+
+    // 一輪事件處理完，把這輪有變動的對局寫進快照檔；一場對局一輪最多寫一次
+    void write_snapshots() {
+        for (size_t i = 0; i < snapshot_list.size(); i++) {
+            Match* m = snapshot_list[i];
+            // 對局可能已在這輪結束（格子已清除）
+            if (!m->snapshot_dirty) continue;
+            m->snapshot_dirty = false;
+            if (m->id == 0 || m->snapshot_slot < 0) continue;
+
+            SnapshotRecord r;
+            memset(&r, 0, sizeof(r));
+            r.match_id = m->id;
+            r.move_count = (uint8_t)std::min(m->moves_played, RECORD_MAX_MOVES);
+            r.current_turn = (uint8_t)m->current_turn;
+            r.practice = m->practice ? 1 : 0;
+            r.black = m->game.get_black_board();
+            r.white = m->game.get_white_board();
+            for (int k = 0; k < 2; k++) {
+                r.secrets[k] = m->secrets[k];
+                r.pieces[k] = (uint8_t)m->pieces[k];
+                r.is_ai[k] = m->players[k]->is_ai ? 1 : 0;
+                memcpy(r.names[k], m->players[k]->name, sizeof(r.names[k]));
+            }
+            memcpy(r.moves, m->moves, r.move_count);
+            snapshots->write(m->snapshot_slot, r);
+        }
+        snapshot_list.clear();
+    }
+
+#if METRICS_ENABLED
+    // 在事件迴圈的空檔複製統計，下棋路徑上不必為了匯出而加鎖
+    void publish_metrics() {
+        metrics.set(GAUGE_CONNECTIONS, connection_pool.used());
+        metrics.set(GAUGE_MATCHES, match_pool.used());
+        metrics.set(GAUGE_SPECTATORS, spectator_total);
+        metrics.set(GAUGE_WAITING, waiting.size());
+        metrics.set(GAUGE_AI_SEARCHES, ai_searches);
+        {
+            std::lock_guard<std::mutex> lock(inbox_mutex);
+            metrics.set(GAUGE_INBOX, inbox.size() + ai_inbox.size() + handoff_inbox.size());
+        }
+        {
+            std::lock_guard<std::mutex> lock(metrics_mutex);
+            published_metrics = metrics;
+            metrics_generation++;
+            metrics_requested = false;
+        }
+        metrics_ready.notify_all();
+    }
+#endif
+
+    void free_closed() {
+        for (size_t i = 0; i < closed_list.size(); i++) {
+            connection_pool.release(closed_list[i]);
+        }
+        closed_list.clear();
+    }
+
+public:
+    Shard(int shard_index, const ServerConfig& server_config, AIService* ai_service, RecordWriter* writer,
+          const OpeningBook* opening_book, MatchDirectory* matches)
+        : load(0), unpaired(0), moves_played(0), write_calls(0) {
+        now_tick = 0;
+        spectator_total = 0;
+        ai_searches = 0;
+#if METRICS_ENABLED
+        metrics_requested = false;
+        metrics_generation = 0;
+#endif
+        start_time = std::chrono::steady_clock::now();
+        index = shard_index;
+        epoll_fd = -1;
+        wake_fd = -1;
+        config = server_config;
+        ai = ai_service;
+        records = writer;
+        book = opening_book;
+        directory = matches;
+        snapshots = NULL;
+        rand_seed = time(NULL) + shard_index;
+        std::random_device seed;
+        token_rng.seed(((uint64_t)seed() << 32) ^ seed());
+    }
+
+    ~Shard() {
+        if (wake_fd != -1) close(wake_fd);
+        if (epoll_fd != -1) close(epoll_fd);
+    }
+
+    bool init() {
+        epoll_fd = epoll_create1(0);
+        wake_fd = eventfd(0, EFD_NONBLOCK);
+        if (epoll_fd < 0 || wake_fd < 0) {
+            std::cerr << "Shard " << index << ": epoll/eventfd creation failed\n";
+            return false;
+        }
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLET;
+        ev.data.ptr = NULL;  // NULL 代表 wake_fd
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev) < 0) {
+            std::cerr << "Shard " << index << ": epoll_ctl failed\n";
+            return false;
+        }
+        return true;
+    }
+
+    int get_load() const { return load; }
+    int get_unpaired() const { return unpaired; }
+    uint64_t get_moves_played() const { return moves_played.load(std::memory_order_relaxed); }
+    uint64_t get_write_calls() const { return write_calls.load(std::memory_order_relaxed); }
+
+    // 啟動時由 Server 呼叫（shard 執行緒還沒開始）：這個 shard 使用快照檔中 [first, first + count) 的格子
+    void attach_snapshots(SnapshotFile* file, uint32_t first, uint32_t count) {
+        snapshots = file;
+        for (uint32_t i = first + count; i > first; i--) {
+            free_slots.push_back(i - 1);
+        }
+    }
+
+    // 啟動時由 Server 呼叫：重播快照中的棋譜並和存下的棋盤比對，不一致的快照不還原。
+    // 電腦照常接手，玩家的座位先空著，RESUME_TIMEOUT_SECONDS 內沒帶 token 回來就判負
+    bool restore_match(const SnapshotRecord& r) {
+        if (r.current_turn > 1 || r.move_count > RECORD_MAX_MOVES ||
+            !((r.pieces[0] == 'X' && r.pieces[1] == 'O') || (r.pieces[0] == 'O' && r.pieces[1] == 'X'))) {
+            return false;
+        }
+        Game game;
+        char player = 'X';
+        for (int i = 0; i < r.move_count; i++) {
+            if (!game.has_valid_moves(player)) {
+                player = (player == 'X') ? 'O' : 'X';
+            }
+            int sq = r.moves[i];
+            if (sq >= 64 || !game.make_move(sq / 8, sq % 8, player)) {
                 return false;
             }
+            player = (player == 'X') ? 'O' : 'X';
+        }
+        if (game.get_black_board() != r.black || game.get_white_board() != r.white) {
+            return false;
+        }
+
+        Connection* seats[2];
+        for (int k = 0; k < 2; k++) {
+            if (r.is_ai[k]) {
+                seats[k] = new_ai_player();
+                continue;
+            }
+            Connection* c = new_connection(-1);
+            memcpy(c->name, r.names[k], MAX_NAME_LENGTH);
+            c->name[MAX_NAME_LENGTH] = '\0';
+            c->named = true;
+            c->vacant = true;
+            c->protocol = PROTO_BINARY;
+            timers.schedule(&c->timer, now_tick + seconds_to_ticks(RESUME_TIMEOUT_SECONDS));
+            seats[k] = c;
         }
-        
+
+        Match* m = new_match(r.match_id, seats[0], seats[1], r.practice != 0);
+        m->game = game;
+        m->pieces[0] = r.pieces[0];
+        m->pieces[1] = r.pieces[1];
+        m->current_turn = r.current_turn;
+        m->moves_played = r.move_count;
+        memcpy(m->moves, r.moves, r.move_count);
+        m->secrets[0] = r.secrets[0];
+        m->secrets[1] = r.secrets[1];
+        mark_snapshot(m);
+        begin_turn(m);
+        // 立刻寫回，Server 以新的快照檔取代舊檔之前，還原的對局都已在新檔中
+        write_snapshots();
         return true;
     }
-    
-    std::string receive_message(int client_idx) {
-        char buffer[BUFFER_SIZE] = {0};
-        int valread = read(client_sockets[client_idx], buffer, BUFFER_SIZE);
-        if (valread <= 0) {
-            return "";
+
+    // 由其他 shard 呼叫：觀眾要看的對局、或玩家要回去的座位在這個 shard
+    // input 是原本的 shard 已讀進來、還沒處理的資料，在這裡接著處理
+    void adopt_connection(int fd, int match_id, bool resume, uint64_t secret, const uint8_t* input, size_t length) {
+        load++;
+        MatchHandoff handoff;
+        handoff.fd = fd;
+        handoff.match_id = match_id;
+        handoff.resume = resume;
+        handoff.secret = secret;
+        handoff.input.assign(input, input + length);
+        {
+            std::lock_guard<std::mutex> lock(inbox_mutex);
+            handoff_inbox.push_back(std::move(handoff));
+        }
+        wake();
+    }
+
+    // 由 acceptor 執行緒呼叫，把新連線交給這個 shard
+    void hand_off(int fd, uint64_t accepted_at) {
+        load++;
+        unpaired++;
+        PendingConnection pending;
+        pending.fd = fd;
+        pending.accepted_at = accepted_at;
+        {
+            std::lock_guard<std::mutex> lock(inbox_mutex);
+            inbox.push_back(pending);
+        }
+        wake();
+    }
+
+#if METRICS_ENABLED
+    // 由匯出統計的執行緒呼叫：請 shard 複製一份統計，最多等 METRICS_WAIT_MS；
+    // shard 一直在忙（例如大量連線湧入）時回傳上一份快照
+    void collect_metrics(ShardMetrics& out) {
+        std::unique_lock<std::mutex> lock(metrics_mutex);
+        uint64_t generation = metrics_generation;
+        metrics_requested = true;
+        wake();
+        metrics_ready.wait_for(lock, std::chrono::milliseconds(METRICS_WAIT_MS),
+                               [this, generation]() { return metrics_generation != generation; });
+        out = published_metrics;
+    }
+#endif
+
+    // 事件迴圈：這個 shard 的所有對局都在此執行緒推進
+    void run() {
+        struct epoll_event events[MAX_EVENTS];
+
+        while (true) {
+            // 有人在等配對時定時醒來，檢查是否要由電腦補位；時間輪有計時器時最晚在下一個到期的格子醒來
+            int timeout = (config.ai_fill_seconds > 0 && !waiting.empty()) ? 1000 : -1;
+            int ticks = timers.ticks_until_next();
+            if (ticks >= 0 && (timeout < 0 || ticks * TIMER_TICK_MS < timeout)) {
+                timeout = ticks * TIMER_TICK_MS;
+            }
+            int n = epoll_wait(epoll_fd, events, MAX_EVENTS, timeout);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                std::cerr << "epoll_wait failed: " << strerror(errno) << "\n";
+                return;
+            }
+            now_tick = current_tick();
+
+            for (int i = 0; i < n; i++) {
+                Connection* c = (Connection*)events[i].data.ptr;
+                if (c == NULL) {
+                    drain_inbox();
+                    continue;
+                }
+                if (c->closed) continue;
+
+                // 先讀完剩下的資料（讀到 EOF 時會自行處理斷線），再處理對方關閉的事件
+                if (events[i].events & EPOLLIN) {
+                    handle_readable(c);
+                }
+                if (!c->closed && (events[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+                    handle_disconnect(c);
+                    continue;
+                }
+
+                // socket 又可寫了：送出之前 EAGAIN 留下的資料。本輪有新輸出的連線留到 flush_dirty 一起送
+                if ((events[i].events & EPOLLOUT) && !c->closed && !c->dirty && has_pending_output(c)) {
+                    if (!flush_output(c)) {
+                        handle_disconnect(c);
+                    } else if (c->draining && !has_pending_output(c)) {
+                        close_connection(c);
+                    } else {
+                        resume_if_drained(c);
+                    }
+                }
+            }
+
+            // 先處理本輪收到的棋步，同時到期的每步時限才不會誤判
+            timers.advance(now_tick, [this](Timer* t) { handle_timer(t); });
+            fill_waiting_with_ai();
+            write_snapshots();
+            flush_dirty();
+            free_closed();
+#if METRICS_ENABLED
+            if (metrics_requested.load(std::memory_order_relaxed)) {
+                publish_metrics();
+            }
+#endif
+        }
+    }
+};
+
+class Server {
+private:
+    int server_fd;
+    std::vector<Shard*> shards;
+    TranspositionTable tt;
+    AIService ai;          // 在 tt 之後建構
+    RecordWriter records;
+    std::string record_path;
+    OpeningBook book;
+    std::string book_path;
+    PatternEvaluator evaluator;
+    std::string weights_path;
+    MatchDirectory directory;
+    SnapshotFile snapshots;
+    std::string snapshot_path;
+    int stats_seconds;
+    int metrics_port;
+    int metrics_fd;
+
+    // 挑選新連線的 shard：有人落單等配對的 shard 優先，否則選連線數最少的
+    Shard* pick_shard() {
+        Shard* best = NULL;
+        for (size_t i = 0; i < shards.size(); i++) {
+            if (shards[i]->get_unpaired() % 2 == 1 &&
+                (best == NULL || shards[i]->get_load() < best->get_load())) {
+                best = shards[i];
+            }
+        }
+        if (best != NULL) return best;
+
+        best = shards[0];
+        for (size_t i = 1; i < shards.size(); i++) {
+            if (shards[i]->get_load() < best->get_load()) {
+                best = shards[i];
+            }
         }
-        return std::string(buffer);
+        return best;
     }
-    
+
 public:
-    Server() {
+    Server(const ServerConfig& config)
+        : tt(config.tt_megabytes), ai(&tt, config.ai_workers, config.search_threads, config.endgame_empties) {
         server_fd = -1;
-        client_sockets[0] = -1;
-        client_sockets[1] = -1;
-        game = new Game();
-        current_turn = 0;
+        metrics_fd = -1;
+        stats_seconds = config.stats_seconds;
+        metrics_port = config.metrics_port;
+        record_path = config.record_path;
+        book_path = config.book_path;
+        weights_path = config.weights_path;
+        snapshot_path = config.snapshot_path;
+        for (int i = 0; i < config.threads; i++) {
+            shards.push_back(new Shard(i, config, &ai, record_path.empty() ? NULL : &records, &book, &directory));
+        }
     }
-    
+
     ~Server() {
-        if (game) delete game;
-        if (client_sockets[0] != -1) close(client_sockets[0]);
-        if (client_sockets[1] != -1) close(client_sockets[1]);
+        for (size_t i = 0; i < shards.size(); i++) {
+            delete shards[i];
+        }
         if (server_fd != -1) close(server_fd);
+        if (metrics_fd != -1) close(metrics_fd);
     }
-    
+
     bool start(const std::string& ip, int port) {
+        // 每場對局佔兩個 fd，把上限調到系統允許的最大值
+        struct rlimit rl;
+        if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+            rl.rlim_cur = rl.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &rl);
+        }
+
         server_fd = socket(AF_INET, SOCK_STREAM, 0);
-        if (server_fd == 0) {
+        if (server_fd < 0) {
             std::cerr << "Socket creation failed\n";
             return false;
         }
-        
+
         int opt = 1;
         if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR | SO_REUSEPORT, &opt, sizeof(opt))) {
             std::cerr << "Setsockopt failed\n";
             return false;
         }
-        
+
         struct sockaddr_in address;
         address.sin_family = AF_INET;
         address.sin_addr.s_addr = inet_addr(ip.c_str());
         address.sin_port = htons(port);
-        
+
         if (bind(server_fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
             std::cerr << "Bind failed\n";
             return false;
         }
-        
-        if (listen(server_fd, 2) < 0) {
+
+        if (listen(server_fd, SOMAXCONN) < 0) {
             std::cerr << "Listen failed\n";
             return false;
         }
-        
-        std::cout << "Server started on " << ip << ":" << port << "\n";
+
+        for (size_t i = 0; i < shards.size(); i++) {
+            if (!shards[i]->init()) {
+                return false;
+            }
+        }
+
+        if (!record_path.empty() && !records.open(record_path)) {
+            return false;
+        }
+        // 開局庫直接 mmap，不需解析
+        if (!book_path.empty()) {
+            if (!book.open(book_path)) {
+                return false;
+            }
+            std::cout << "Opening book: " << book.size() << " positions\n";
+        }
+        if (!weights_path.empty()) {
+            if (!evaluator.load(weights_path)) {
+                return false;
+            }
+            std::cout << "Pattern evaluation: " << weights_path
+                      << (evaluator.is_vectorized() ? " (avx2)" : "") << "\n";
+            ai.set_evaluator(&evaluator);   // shard 還沒開始，不會有搜尋在進行
+        }
+
+        if (!snapshot_path.empty() && !restore_snapshots()) {
+            return false;
+        }
+        if (metrics_port > 0 && !open_metrics_socket()) {
+            return false;
+        }
+
+        std::cout << "Server started on " << ip << ":" << port
+                  << " (" << shards.size() << " reactor threads, " << ai.size() << " AI workers)\n";
         std::cout << "Waiting for players...\n";
-        
+
         return true;
     }
-    
-    void wait_for_players() {
-        struct sockaddr_in address;
-        int addrlen = sizeof(address);
-        
-        client_sockets[0] = accept(server_fd, (struct sockaddr*)&address, (socklen_t*)&addrlen);
-        if (client_sockets[0] < 0) {
-            std::cerr << "Accept failed for player 1\n";
-            return;
+
+    // 定時印出這段期間的棋步數、送出資料的系統呼叫次數與 heap 配置次數；穩定對局時每步的配置應接近 0。
+    // 另外印出電腦實際搜尋、命中快取與和其他對局共用結果的次數
+    void report_stats() {
+        uint64_t last_moves = 0;
+        uint64_t last_writes = 0;
+        uint64_t last_allocations = allocation_count();
+        uint64_t last_searches = 0;
+        uint64_t last_cache_hits = 0;
+        uint64_t last_coalesced = 0;
+        while (true) {
+            sleep(stats_seconds);
+            uint64_t moves = 0;
+            uint64_t writes = 0;
+            int connections = 0;
+            for (size_t i = 0; i < shards.size(); i++) {
+                moves += shards[i]->get_moves_played();
+                writes += shards[i]->get_write_calls();
+                connections += shards[i]->get_load();
+            }
+            uint64_t allocations = allocation_count();
+            uint64_t delta_moves = moves - last_moves;
+            uint64_t delta_writes = writes - last_writes;
+            uint64_t delta_allocations = allocations - last_allocations;
+
+            std::ostringstream line;
+            line << "stats: " << connections << " connections, " << delta_moves << " moves, "
+                 << delta_writes << " writes, " << delta_allocations << " allocations";
+            if (delta_moves > 0) {
+                line << " (per move: " << (double)delta_writes / delta_moves << " writes, "
+                     << (double)delta_allocations / delta_moves << " allocations)";
+            }
+            uint64_t searches, cache_hits, coalesced;
+            ai.get_counts(searches, cache_hits, coalesced);
+            line << ", ai: " << searches - last_searches << " searches, " << cache_hits - last_cache_hits
+                 << " cached, " << coalesced - last_coalesced << " shared, " << ai.get_queued() << " queued";
+            log_line(line.str());
+            last_searches = searches;
+            last_cache_hits = cache_hits;
+            last_coalesced = coalesced;
+
+            last_moves = moves;
+            last_writes = writes;
+            last_allocations = allocation_count();  // 不把上面印 log 的配置算進下一段
         }
-        
-        player_names[0] = receive_message(0);
-        std::cout << "Player 1 connected: " << player_names[0] << "\n";
-        send_message(0, "WAIT:Waiting for another player...");
-        
-        client_sockets[1] = accept(server_fd, (struct sockaddr*)&address, (socklen_t*)&addrlen);
-        if (client_sockets[1] < 0) {
-            std::cerr << "Accept failed for player 2\n";
-            return;
+    }
+
+    // 讀出上次執行時仍在進行的對局，平均分給各 shard 還原；每個 shard 使用快照檔中自己的一段格子
+    bool restore_snapshots() {
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        std::vector<SnapshotRecord> recovered;
+        if (!snapshots.open(snapshot_path, (uint32_t)shards.size() * SNAPSHOT_SLOTS_PER_SHARD, recovered)) {
+            return false;
+        }
+        for (size_t i = 0; i < shards.size(); i++) {
+            shards[i]->attach_snapshots(&snapshots, (uint32_t)i * SNAPSHOT_SLOTS_PER_SHARD, SNAPSHOT_SLOTS_PER_SHARD);
+        }
+        // 新對局的編號接在還原的對局之後，token 與對局目錄才不會撞號
+        int restored = 0;
+        int max_id = 0;
+        for (size_t i = 0; i < recovered.size(); i++) {
+            max_id = std::max(max_id, (int)recovered[i].match_id);
+        }
+        next_match_id = max_id;
+        for (size_t i = 0; i < recovered.size(); i++) {
+            if (shards[i % shards.size()]->restore_match(recovered[i])) restored++;
+        }
+        if (!snapshots.commit()) {
+            return false;
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+        std::cout << "Snapshots: " << snapshot_path << ", restored " << restored << " of " << recovered.size()
+                  << " matches in " << ms << " ms\n";
+        return true;
+    }
+
+    // 統計只開在本機，給同一台機器上的 Prometheus 或 curl 讀取
+    bool open_metrics_socket() {
+#if METRICS_ENABLED
+        metrics_fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (metrics_fd < 0) {
+            std::cerr << "Metrics socket creation failed\n";
+            return false;
+        }
+        int opt = 1;
+        setsockopt(metrics_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+        struct sockaddr_in address;
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(metrics_port);
+        if (bind(metrics_fd, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(metrics_fd, 16) < 0) {
+            std::cerr << "Metrics bind failed on port " << metrics_port << "\n";
+            return false;
         }
-        
-        player_names[1] = receive_message(1);
-        std::cout << "Player 2 connected: " << player_names[1] << "\n";
-        
-        srand(time(NULL));
-        current_turn = rand() % 2;
-        player_pieces[current_turn] = 'X';
-        player_pieces[1 - current_turn] = 'O';
-        
-        std::string start_msg_0 = "START:" + player_names[1] + ":" + std::string(1, player_pieces[0]);
-        std::string start_msg_1 = "START:" + player_names[0] + ":" + std::string(1, player_pieces[1]);
-        
-        send_message(0, start_msg_0);
-        send_message(1, start_msg_1);
-        
-        std::cout << player_names[current_turn] << " (" << player_pieces[current_turn] << ") goes first!\n";
-    }
-    
-    void run_game() {
+        std::cout << "Metrics on 127.0.0.1:" << metrics_port << "\n";
+        return true;
+#else
+        std::cerr << "Metrics were disabled at compile time (NO_METRICS)\n";
+        return false;
+#endif
+    }
+
+#if METRICS_ENABLED
+    // 每個連線回應一次目前的統計後關閉；回應加上 HTTP 標頭，Prometheus 可以直接抓取
+    void serve_metrics() {
+        std::vector<ShardMetrics> snapshots(shards.size());
         while (true) {
-            int opponent = 1 - current_turn;
-            
-            // 檢查雙方連線狀態
-            if (!check_client_connected(current_turn)) {
-                std::cout << player_names[current_turn] << " disconnected\n";
-                send_message(opponent, "OPPONENT_DISCONNECT:");
-                break;
+            int fd = accept(metrics_fd, NULL, NULL);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) continue;
+                std::cerr << "Metrics accept failed: " << strerror(errno) << "\n";
+                return;
             }
-            if (!check_client_connected(opponent)) {
-                std::cout << player_names[opponent] << " disconnected\n";
-                send_message(current_turn, "OPPONENT_DISCONNECT:");
-                break;
+
+            // 讀掉請求（內容不重要）；不送請求的 client 最多等一秒，之後照樣回應，方便用 nc 直接讀
+            struct timeval timeout = {1, 0};
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            char request[1024];
+            ssize_t request_length = read(fd, request, sizeof(request));
+            (void)request_length;
+
+            for (size_t i = 0; i < shards.size(); i++) {
+                shards[i]->collect_metrics(snapshots[i]);
             }
-            
-            if (!game->has_valid_moves(player_pieces[current_turn])) {
-                if (!game->has_valid_moves(player_pieces[opponent])) {
-                    std::string result = game->get_result();
-                    std::string end_msg = "END:" + result + ":" + game->get_board_state();
-                    send_message(0, end_msg);
-                    send_message(1, end_msg);
-                    std::cout << "Game over: " << result << "\n";
-                    break;
-                } else {
-                    std::cout << player_names[current_turn] << " has no valid moves, skipping...\n";
-                    std::string skip_msg = "SKIP:" + game->get_board_state();
-                    send_message(current_turn, skip_msg);
-                    send_message(opponent, "OPPONENT_SKIP:" + game->get_board_state());
-                    current_turn = opponent;
-                    continue;
-                }
+            std::string body = format_prometheus(snapshots.data(), (int)snapshots.size());
+            std::ostringstream response;
+            response << "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: "
+                     << body.size() << "\r\n\r\n" << body;
+            std::string data = response.str();
+            size_t sent = 0;
+            while (sent < data.size()) {
+                ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+                if (n <= 0) break;
+                sent += n;
             }
-            
-            // 發送遊戲狀態給兩個玩家
-            std::string state_current = "YOUR_TURN:" + game->get_board_state();
-            std::string state_opponent = "OPPONENT_TURN:" + game->get_board_state();
-            
-            send_message(current_turn, state_current);
-            send_message(opponent, state_opponent);
-            
-            // 等待當前玩家的移動
-            bool valid_move = false;
-            while (!valid_move) {
-                // 再次檢查連線（在等待輸入時）
-                if (!check_client_connected(current_turn)) {
-                    std::cout << player_names[current_turn] << " disconnected\n";
-                    send_message(opponent, "OPPONENT_DISCONNECT:");
-                    return;
-                }
-                if (!check_client_connected(opponent)) {
-                    std::cout << player_names[opponent] << " disconnected\n";
-                    send_message(current_turn, "OPPONENT_DISCONNECT:");
-                    return;
-                }
-                
-                std::string move = receive_message(current_turn);
-                if (move.empty()) {
-                    std::cout << player_names[current_turn] << " disconnected\n";
-                    send_message(opponent, "OPPONENT_DISCONNECT:");
-                    return;
-                }
-                
-                int row, col;
-                if (!game->parse_move(move, row, col)) {
-                    send_message(current_turn, "INVALID:Invalid position format");
-                    continue;
-                }
-                
-                if (!game->is_valid_move(row, col, player_pieces[current_turn])) {
-                    send_message(current_turn, "INVALID:Invalid move");
+            close(fd);
+        }
+    }
+#endif
+
+    // 主執行緒只負責 accept，連線交給各 shard 的 reactor 執行緒處理
+    void run() {
+        for (size_t i = 0; i < shards.size(); i++) {
+            std::thread(&Shard::run, shards[i]).detach();
+        }
+        if (stats_seconds > 0) {
+            std::thread(&Server::report_stats, this).detach();
+        }
+#if METRICS_ENABLED
+        if (metrics_fd != -1) {
+            std::thread(&Server::serve_metrics, this).detach();
+        }
+#endif
+
+        while (true) {
+            struct sockaddr_in address;
+            socklen_t addrlen = sizeof(address);
+            int fd = accept4(server_fd, (struct sockaddr*)&address, &addrlen, SOCK_NONBLOCK);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) continue;
+                std::cerr << "Accept failed: " << strerror(errno) << "\n";
+                if (errno == EMFILE || errno == ENFILE) {
+                    usleep(10000);  // fd 用完時稍等，避免空轉
                     continue;
                 }
-                
-                game->make_move(row, col, player_pieces[current_turn]);
-                std::cout << player_names[current_turn] << " (" << player_pieces[current_turn] 
-                         << ") played " << move << "\n";
-                
-                // 發送 OK 給當前玩家
-                send_message(current_turn, "MOVE_OK:" + move);
-                
-                valid_move = true;
+                return;
             }
-            
-            current_turn = opponent;
+
+            int opt = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+
+            pick_shard()->hand_off(fd, metrics_now());
         }
     }
 };
 
 int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        std::cout << "Usage: " << argv[0] << " <ip> <port>\n";
+    if (argc < 3) {
+        std::cout << "Usage: " << argv[0] << " <ip> <port> [-v] [-t threads] [-a ai_fill_seconds] [-m ai_ms] [-h tt_mb] [-s search_threads] [-n ai_workers] [-e endgame_empties] [-i stats_seconds] [-c turn_seconds] [-k heartbeat_seconds] [-r record_file] [-b book_file] [-w weights_file] [-p metrics_port] [-f snapshot_file]\n";
         return 1;
     }
-    
+
     std::string ip = argv[1];
     int port = atoi(argv[2]);
-    
-    Server server;
+
+    ServerConfig config;
+    config.verbose = false;
+    config.threads = std::thread::hardware_concurrency();
+    config.ai_fill_seconds = 0;
+    config.ai_time_ms = 1000;
+    config.tt_megabytes = 64;
+    config.search_threads = 1;
+    config.ai_workers = std::thread::hardware_concurrency();
+    config.endgame_empties = 20;
+    config.stats_seconds = 0;
+    config.turn_seconds = 60;
+    config.heartbeat_seconds = 15;
+    config.record_path = "games.rec";
+    config.book_path = "";
+    config.weights_path = "";
+    config.metrics_port = 0;
+    config.snapshot_path = "";
+
+    for (int i = 3; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-v") {
+            config.verbose = true;
+        } else if (arg == "-t" && i + 1 < argc) {
+            config.threads = atoi(argv[++i]);
+        } else if (arg == "-a" && i + 1 < argc) {
+            config.ai_fill_seconds = atoi(argv[++i]);
+        } else if (arg == "-m" && i + 1 < argc) {
+            config.ai_time_ms = atoi(argv[++i]);
+        } else if (arg == "-h" && i + 1 < argc) {
+            config.tt_megabytes = atoi(argv[++i]);
+        } else if (arg == "-s" && i + 1 < argc) {
+            config.search_threads = atoi(argv[++i]);
+        } else if (arg == "-n" && i + 1 < argc) {
+            config.ai_workers = atoi(argv[++i]);
+        } else if (arg == "-e" && i + 1 < argc) {
+            config.endgame_empties = atoi(argv[++i]);
+        } else if (arg == "-i" && i + 1 < argc) {
+            config.stats_seconds = atoi(argv[++i]);
+        } else if (arg == "-c" && i + 1 < argc) {
+            config.turn_seconds = atoi(argv[++i]);
+        } else if (arg == "-k" && i + 1 < argc) {
+            config.heartbeat_seconds = atoi(argv[++i]);
+        } else if (arg == "-r" && i + 1 < argc) {
+            config.record_path = argv[++i];
+            if (config.record_path == "none") config.record_path = "";
+        } else if (arg == "-b" && i + 1 < argc) {
+            config.book_path = argv[++i];
+        } else if (arg == "-w" && i + 1 < argc) {
+            config.weights_path = argv[++i];
+        } else if (arg == "-f" && i + 1 < argc) {
+            config.snapshot_path = argv[++i];
+        } else if (arg == "-p" && i + 1 < argc) {
+            config.metrics_port = atoi(argv[++i]);
+        } else {
+            std::cout << "Unknown option: " << arg << "\n";
+            return 1;
+        }
+    }
+    if (config.threads <= 0) config.threads = 1;
+    if (config.ai_time_ms <= 0) config.ai_time_ms = 1000;
+    if (config.tt_megabytes < 0) config.tt_megabytes = 0;
+    if (config.search_threads <= 0) config.search_threads = 1;
+    if (config.ai_workers <= 0) config.ai_workers = 1;
+    if (config.endgame_empties < 0) config.endgame_empties = 0;
+    if (config.endgame_empties > ENDGAME_MAX_EMPTIES) config.endgame_empties = ENDGAME_MAX_EMPTIES;
+    if (config.stats_seconds < 0) config.stats_seconds = 0;
+    if (config.turn_seconds < 0) config.turn_seconds = 0;
+    if (config.heartbeat_seconds < 0) config.heartbeat_seconds = 0;
+    if (config.metrics_port < 0) config.metrics_port = 0;
+
+    Server server(config);
     if (!server.start(ip, port)) {
         return 1;
     }
-    
-    server.wait_for_players();
-    server.run_game();
-    
+
+    server.run();
+
     return 0;
 }
\ No newline at end of file
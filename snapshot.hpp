@@ -0,0 +1,196 @@
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include "protocol.hpp"
+#include "record.hpp"
+
+// 進行中對局的快照檔：固定大小的格子陣列，整個 mmap 進來，每場對局佔一格。
+// 寫入只是把一筆快照複製進共享的記憶體，process 當掉時資料仍在 page cache，重新啟動就讀得到
+// （整台機器當掉則要等核心寫回磁碟）。每格有兩份，輪流寫入、各自附 checksum：
+// 寫到一半就當掉時，那一份驗證失敗，改用另一份（少一步的狀態），不會讀到半新半舊的對局。
+// 重新啟動時在暫存檔建立新的表，寫入還原的對局後才 rename 蓋掉舊檔，中途當掉舊檔仍完整。
+// 檔案只給同一台機器重新啟動時讀，整數用本機的位元組順序
+#define SNAPSHOT_MAGIC "RVSN"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_SLOTS_PER_SHARD 4096   // 每個 shard 最多同時保存幾場對局
+
+struct SnapshotHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t slot_count;
+    uint32_t reserved;
+};
+
+// 一場對局的狀態；棋盤可由棋譜重播，仍一起存下來作為驗證
+struct SnapshotRecord {
+    uint32_t checksum;        // 其餘欄位的 FNV-1a
+    uint32_t sequence;        // 這一格每寫一次加一，兩份中較大的是最新的；0 表示從未寫入
+    uint32_t match_id;        // 0 表示這一格是空的
+    uint8_t move_count;
+    uint8_t current_turn;     // 輪到哪個座位
+    uint8_t practice;
+    uint8_t reserved;
+    uint64_t black;
+    uint64_t white;
+    uint64_t secrets[2];      // 兩個座位的續局 token（秘密值部分）
+    uint8_t pieces[2];        // 'X' 或 'O'
+    uint8_t is_ai[2];
+    uint8_t padding[4];
+    char names[2][MAX_NAME_LENGTH + 1];
+    uint8_t moves[RECORD_MAX_MOVES];
+    uint8_t padding2[6];
+};
+
+static_assert(sizeof(SnapshotHeader) == 16, "SnapshotHeader must be 16 bytes");
+static_assert(sizeof(SnapshotRecord) == 192, "SnapshotRecord must be 192 bytes");
+
+static inline uint32_t snapshot_checksum(const SnapshotRecord& r) {
+    const uint8_t* p = (const uint8_t*)&r + sizeof(r.checksum);
+    const uint8_t* end = (const uint8_t*)&r + sizeof(r);
+    uint32_t h = 2166136261u;
+    while (p < end) {
+        h = (h ^ *p++) * 16777619u;
+    }
+    return h;
+}
+
+class SnapshotFile {
+private:
+    void* mapping;
+    size_t mapping_size;
+    SnapshotRecord* records;          // slot_count * 2 筆，第 i 格是 records[2i] 與 records[2i + 1]
+    uint32_t slot_count;
+    std::vector<uint32_t> sequences;  // 每格最後寫入的 sequence；每格只由擁有它的 shard 寫
+    std::string path;
+    std::string temp_path;            // commit 之前寫在這裡，open 讀的舊檔保持不動
+
+    static bool valid(const SnapshotRecord& r) {
+        return r.sequence != 0 && r.checksum == snapshot_checksum(r);
+    }
+
+    // 舊檔案中每一格最新且完整的一份
+    void collect(const uint8_t* base, size_t size, std::vector<SnapshotRecord>& recovered) {
+        const SnapshotHeader* header = (const SnapshotHeader*)base;
+        if (size < sizeof(SnapshotHeader) || memcmp(header->magic, SNAPSHOT_MAGIC, 4) != 0 ||
+            header->version != SNAPSHOT_VERSION) {
+            return;
+        }
+        size_t count = std::min((size_t)header->slot_count,
+                                (size - sizeof(SnapshotHeader)) / (2 * sizeof(SnapshotRecord)));
+        const SnapshotRecord* old = (const SnapshotRecord*)(base + sizeof(SnapshotHeader));
+        for (size_t i = 0; i < count; i++) {
+            const SnapshotRecord* a = &old[2 * i];
+            const SnapshotRecord* b = &old[2 * i + 1];
+            const SnapshotRecord* latest = NULL;
+            if (valid(*a)) latest = a;
+            if (valid(*b) && (latest == NULL || b->sequence > latest->sequence)) latest = b;
+            if (latest != NULL && latest->match_id != 0) {
+                recovered.push_back(*latest);
+            }
+        }
+    }
+
+public:
+    SnapshotFile() : mapping(NULL), mapping_size(0), records(NULL), slot_count(0) {}
+
+    ~SnapshotFile() {
+        if (mapping != NULL) munmap(mapping, mapping_size);
+    }
+
+    // 讀出舊檔案中仍在進行的對局，並在暫存檔建立 slots 格的空表；
+    // 呼叫端把還原的對局寫入後呼叫 commit，在那之前舊檔不會被改動
+    bool open(const std::string& file_path, uint32_t slots, std::vector<SnapshotRecord>& recovered) {
+        path = file_path;
+        temp_path = file_path + ".tmp";
+
+        int old_fd = ::open(path.c_str(), O_RDONLY);
+        if (old_fd >= 0) {
+            struct stat st;
+            if (fstat(old_fd, &st) == 0 && st.st_size > 0) {
+                void* old = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, old_fd, 0);
+                if (old != MAP_FAILED) {
+                    collect((const uint8_t*)old, st.st_size, recovered);
+                    munmap(old, st.st_size);
+                }
+            }
+            ::close(old_fd);
+        } else if (errno != ENOENT) {
+            std::cerr << "Cannot open snapshot file " << path << ": " << strerror(errno) << "\n";
+            return false;
+        }
+
+        // 新檔案全為 0（稀疏檔，不佔實際空間）
+        int fd = ::open(temp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            std::cerr << "Cannot create snapshot file " << temp_path << ": " << strerror(errno) << "\n";
+            return false;
+        }
+        mapping_size = sizeof(SnapshotHeader) + (size_t)slots * 2 * sizeof(SnapshotRecord);
+        if (ftruncate(fd, mapping_size) < 0) {
+            std::cerr << "Cannot resize snapshot file " << temp_path << ": " << strerror(errno) << "\n";
+            ::close(fd);
+            return false;
+        }
+        mapping = mmap(NULL, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED) {
+            std::cerr << "Cannot map snapshot file " << path << ": " << strerror(errno) << "\n";
+            mapping = NULL;
+            return false;
+        }
+
+        SnapshotHeader* header = (SnapshotHeader*)mapping;
+        memcpy(header->magic, SNAPSHOT_MAGIC, 4);
+        header->version = SNAPSHOT_VERSION;
+        header->slot_count = slots;
+        header->reserved = 0;
+        records = (SnapshotRecord*)((uint8_t*)mapping + sizeof(SnapshotHeader));
+        slot_count = slots;
+        sequences.assign(slots, 0);
+        return true;
+    }
+
+    // 還原的對局都寫入之後，以新的表取代舊檔；mapping 指向同一個 inode，之後照常寫入
+    bool commit() {
+        if (rename(temp_path.c_str(), path.c_str()) < 0) {
+            std::cerr << "Cannot replace snapshot file " << path << ": " << strerror(errno) << "\n";
+            return false;
+        }
+        return true;
+    }
+
+    // 寫入較舊的那一份；sequence 與 checksum 由這裡填入
+    void write(uint32_t slot, SnapshotRecord& record) {
+        uint32_t sequence = ++sequences[slot];
+        record.sequence = sequence;
+        record.checksum = snapshot_checksum(record);
+        records[2 * slot + (sequence & 1)] = record;
+    }
+
+    // 對局結束：寫入一筆空的快照（兩份中較新的一份為空，這一格就不會被還原）
+    void clear(uint32_t slot) {
+        SnapshotRecord empty;
+        memset(&empty, 0, sizeof(empty));
+        write(slot, empty);
+    }
+
+    uint32_t size() const { return slot_count; }
+
+private:
+    SnapshotFile(const SnapshotFile&);
+    SnapshotFile& operator=(const SnapshotFile&);
+};
+
+#endif // SNAPSHOT_HPP
@@ -0,0 +1,68 @@
+#ifndef SYMMETRY_HPP
+#define SYMMETRY_HPP
+
+#include <stdint.h>
+
+// 棋盤的 8 種對稱（旋轉與鏡射），直接作用在 bitboard 上（bit = row * 8 + col）
+// 編號 s 的 bit 0 為轉置（沿 a8-h1 對角線翻轉）、bit 1 為上下翻轉、bit 2 為左右翻轉，依此順序套用
+#define SYMMETRY_COUNT 8
+
+static inline uint64_t flip_vertical(uint64_t b) {
+    return __builtin_bswap64(b);
+}
+
+static inline uint64_t mirror_horizontal(uint64_t b) {
+    const uint64_t k1 = 0x5555555555555555ULL;
+    const uint64_t k2 = 0x3333333333333333ULL;
+    const uint64_t k4 = 0x0f0f0f0f0f0f0f0fULL;
+    b = ((b >> 1) & k1) | ((b & k1) << 1);
+    b = ((b >> 2) & k2) | ((b & k2) << 2);
+    b = ((b >> 4) & k4) | ((b & k4) << 4);
+    return b;
+}
+
+// (row, col) -> (col, row)
+static inline uint64_t flip_diagonal(uint64_t b) {
+    const uint64_t k1 = 0x5500550055005500ULL;
+    const uint64_t k2 = 0x3333000033330000ULL;
+    const uint64_t k4 = 0x0f0f0f0f00000000ULL;
+    uint64_t t;
+    t = k4 & (b ^ (b << 28));
+    b ^= t ^ (t >> 28);
+    t = k2 & (b ^ (b << 14));
+    b ^= t ^ (t >> 14);
+    t = k1 & (b ^ (b << 7));
+    b ^= t ^ (t >> 7);
+    return b;
+}
+
+static inline uint64_t transform_board(uint64_t b, int symmetry) {
+    if (symmetry & 1) b = flip_diagonal(b);
+    if (symmetry & 2) b = flip_vertical(b);
+    if (symmetry & 4) b = mirror_horizontal(b);
+    return b;
+}
+
+static inline int transform_square(int square, int symmetry) {
+    return __builtin_ctzll(transform_board(1ULL << square, symmetry));
+}
+
+// 8 種對稱中 (black, white) 最小的一種，作為同一類局面的代表；回傳所用的對稱編號
+static inline int canonical_symmetry(uint64_t black, uint64_t white, uint64_t& canonical_black,
+                                     uint64_t& canonical_white) {
+    int best = 0;
+    canonical_black = black;
+    canonical_white = white;
+    for (int s = 1; s < SYMMETRY_COUNT; s++) {
+        uint64_t b = transform_board(black, s);
+        uint64_t w = transform_board(white, s);
+        if (b < canonical_black || (b == canonical_black && w < canonical_white)) {
+            best = s;
+            canonical_black = b;
+            canonical_white = w;
+        }
+    }
+    return best;
+}
+
+#endif // SYMMETRY_HPP
@@ -0,0 +1,149 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <stdint.h>
+#include <deque>
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+
+// work-stealing 執行緒池：每個 worker 有自己的工作佇列，從尾端取自己的工作，
+// 沒有工作時從其他 worker 佇列的前端偷（偷走的是最早放進去、通常也是最大塊的工作）。
+// 每個佇列各有一把鎖，平常只有擁有者在用，幾乎不會互相等待。
+// 適合大量、長短不一、彼此獨立的工作（例如自我對戰的每一盤棋）
+class WorkStealingPool {
+public:
+    typedef std::function<void(int)> Task;   // 參數為執行它的 worker 編號
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<Queue*> queues;
+    std::vector<std::thread> threads;
+    std::mutex idle_mutex;
+    std::condition_variable work_ready;
+    std::condition_variable all_done;
+    std::atomic<size_t> pending;     // 已送出但還沒執行完的工作數
+    std::atomic<uint64_t> steals;
+    size_t next_queue;               // submit 輪流放進各佇列
+    bool stopping;
+
+    bool pop_own(int index, Task& task) {
+        Queue* q = queues[index];
+        std::lock_guard<std::mutex> lock(q->mutex);
+        if (q->tasks.empty()) return false;
+        task.swap(q->tasks.back());
+        q->tasks.pop_back();
+        return true;
+    }
+
+    bool steal(int index, Task& task) {
+        int n = (int)queues.size();
+        for (int i = 1; i < n; i++) {
+            Queue* q = queues[(index + i) % n];
+            std::lock_guard<std::mutex> lock(q->mutex);
+            if (q->tasks.empty()) continue;
+            task.swap(q->tasks.front());
+            q->tasks.pop_front();
+            steals++;
+            return true;
+        }
+        return false;
+    }
+
+    void run(int index) {
+        Task task;
+        while (true) {
+            if (pop_own(index, task) || steal(index, task)) {
+                task(index);
+                task = Task();
+                if (--pending == 0) {
+                    std::lock_guard<std::mutex> lock(idle_mutex);
+                    all_done.notify_all();
+                }
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(idle_mutex);
+            if (stopping) return;
+            // submit 也在 idle_mutex 下放入工作，檢查完到開始等待之間不會漏掉通知
+            if (!has_queued()) {
+                work_ready.wait(lock);
+            }
+        }
+    }
+
+    bool has_queued() {
+        for (size_t i = 0; i < queues.size(); i++) {
+            std::lock_guard<std::mutex> lock(queues[i]->mutex);
+            if (!queues[i]->tasks.empty()) return true;
+        }
+        return false;
+    }
+
+public:
+    explicit WorkStealingPool(int thread_count) : pending(0), steals(0), next_queue(0), stopping(false) {
+        if (thread_count <= 0) thread_count = 1;
+        for (int i = 0; i < thread_count; i++) {
+            queues.push_back(new Queue());
+        }
+        for (int i = 0; i < thread_count; i++) {
+            threads.push_back(std::thread(&WorkStealingPool::run, this, i));
+        }
+    }
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(idle_mutex);
+            stopping = true;
+        }
+        work_ready.notify_all();
+        for (size_t i = 0; i < threads.size(); i++) {
+            threads[i].join();
+        }
+        for (size_t i = 0; i < queues.size(); i++) {
+            delete queues[i];
+        }
+    }
+
+    // 由任何執行緒呼叫；工作輪流放進各 worker 的佇列
+    void submit(const Task& task) {
+        pending++;
+        {
+            std::lock_guard<std::mutex> lock(idle_mutex);
+            Queue* q = queues[next_queue];
+            next_queue = (next_queue + 1) % queues.size();
+            std::lock_guard<std::mutex> queue_lock(q->mutex);
+            q->tasks.push_back(task);
+        }
+        work_ready.notify_one();
+    }
+
+    // 等到所有已送出的工作都執行完
+    void wait() {
+        std::unique_lock<std::mutex> lock(idle_mutex);
+        all_done.wait(lock, [this]() { return pending == 0; });
+    }
+
+    // 最多等 ms 毫秒，全部完成時回傳 true（方便呼叫端定期印出進度）
+    bool wait_for(int ms) {
+        std::unique_lock<std::mutex> lock(idle_mutex);
+        return all_done.wait_for(lock, std::chrono::milliseconds(ms), [this]() { return pending == 0; });
+    }
+
+    int size() const { return (int)threads.size(); }
+    size_t get_pending() const { return pending; }
+    uint64_t get_steals() const { return steals; }
+
+private:
+    WorkStealingPool(const WorkStealingPool&);
+    WorkStealingPool& operator=(const WorkStealingPool&);
+};
+
+#endif // THREAD_POOL_HPP
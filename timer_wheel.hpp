@@ -0,0 +1,138 @@
+#ifndef TIMER_WHEEL_HPP
+#define TIMER_WHEEL_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+
+// 階層式時間輪：4 層、每層 64 格，最底層一格為一個 tick。
+// 加入與取消都是 O(1)；時間前進時只看目前這一格，低層轉完一圈才把上一層對應格子的計時器往下搬。
+// 計時器是侵入式的（嵌在連線與對局物件裡），不配置記憶體。不加鎖，只能由單一執行緒使用
+#define TIMER_TICK_MS 10
+#define TIMER_SLOT_BITS 6
+#define TIMER_SLOTS (1 << TIMER_SLOT_BITS)
+#define TIMER_SLOT_MASK (TIMER_SLOTS - 1)
+#define TIMER_LEVELS 4
+#define TIMER_MAX_DELAY ((1ULL << (TIMER_SLOT_BITS * TIMER_LEVELS)) - 1)   // 約 46 小時
+
+struct Timer {
+    Timer* prev;
+    Timer* next;       // NULL 表示不在時間輪中
+    uint64_t expires;  // 到期的 tick
+    int kind;          // 由使用者自訂，到期時用來分辨是哪一種計時器
+    void* owner;
+
+    Timer() : prev(NULL), next(NULL), expires(0), kind(0), owner(NULL) {}
+
+    bool pending() const { return next != NULL; }
+};
+
+class TimerWheel {
+private:
+    Timer slots[TIMER_LEVELS][TIMER_SLOTS];   // 每一格是環狀雙向串列的哨兵
+    uint64_t now;
+    size_t count;
+
+    void link(Timer* t) {
+        uint64_t delay = t->expires - now;
+        int level = 0;
+        while (level < TIMER_LEVELS - 1 && delay >= (1ULL << (TIMER_SLOT_BITS * (level + 1)))) {
+            level++;
+        }
+        Timer* head = &slots[level][(t->expires >> (TIMER_SLOT_BITS * level)) & TIMER_SLOT_MASK];
+        t->prev = head->prev;
+        t->next = head;
+        head->prev->next = t;
+        head->prev = t;
+    }
+
+    static void unlink(Timer* t) {
+        t->prev->next = t->next;
+        t->next->prev = t->prev;
+        t->prev = NULL;
+        t->next = NULL;
+    }
+
+    // 把上一層某一格的計時器重新放回較低的層
+    void cascade(int level, int index) {
+        Timer* head = &slots[level][index];
+        while (head->next != head) {
+            Timer* t = head->next;
+            unlink(t);
+            link(t);
+        }
+    }
+
+public:
+    explicit TimerWheel(uint64_t start_tick = 0) : now(start_tick), count(0) {
+        for (int level = 0; level < TIMER_LEVELS; level++) {
+            for (int i = 0; i < TIMER_SLOTS; i++) {
+                slots[level][i].prev = &slots[level][i];
+                slots[level][i].next = &slots[level][i];
+            }
+        }
+    }
+
+    // 已在時間輪中的計時器會先取消再重新排入；到期時間不晚於現在時在下一個 tick 觸發
+    void schedule(Timer* t, uint64_t expires) {
+        if (t->pending()) cancel(t);
+        if (expires <= now) expires = now + 1;
+        if (expires - now > TIMER_MAX_DELAY) expires = now + TIMER_MAX_DELAY;
+        t->expires = expires;
+        link(t);
+        count++;
+    }
+
+    void cancel(Timer* t) {
+        if (!t->pending()) return;
+        unlink(t);
+        count--;
+    }
+
+    // 前進到 target，每個到期的計時器先移出時間輪再呼叫 handler(Timer*)；
+    // handler 可以取消其他計時器或重新排入這一個
+    template<typename Handler>
+    void advance(uint64_t target, Handler handler) {
+        if (count == 0) {
+            if (target > now) now = target;
+            return;
+        }
+        while (now < target) {
+            now++;
+            for (int level = 1; level < TIMER_LEVELS; level++) {
+                int shift = TIMER_SLOT_BITS * level;
+                if (now & ((1ULL << shift) - 1)) break;
+                cascade(level, (now >> shift) & TIMER_SLOT_MASK);
+            }
+
+            Timer* head = &slots[0][now & TIMER_SLOT_MASK];
+            while (head->next != head) {
+                Timer* t = head->next;
+                unlink(t);
+                count--;
+                handler(t);
+            }
+            if (count == 0 && target > now) now = target;
+        }
+    }
+
+    // 距離下一次需要 advance 的 tick 數（下一個非空的格子或需要往下搬的時間點），沒有計時器時回傳 -1
+    int ticks_until_next() const {
+        if (count == 0) return -1;
+        for (int i = 1; i <= TIMER_SLOTS; i++) {
+            uint64_t tick = now + i;
+            if ((tick & TIMER_SLOT_MASK) == 0) return i;
+            const Timer* head = &slots[0][tick & TIMER_SLOT_MASK];
+            if (head->next != head) return i;
+        }
+        return TIMER_SLOTS;
+    }
+
+    uint64_t current_tick() const { return now; }
+    size_t size() const { return count; }
+
+private:
+    TimerWheel(const TimerWheel&);
+    TimerWheel& operator=(const TimerWheel&);
+};
+
+#endif // TIMER_WHEEL_HPP
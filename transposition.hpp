@@ -0,0 +1,159 @@
+#ifndef TRANSPOSITION_HPP
+#define TRANSPOSITION_HPP
+
+#include <stdint.h>
+#include <cstdlib>
+#include <atomic>
+
+#define TT_BUCKET_ENTRIES 4
+#define TT_NO_MOVE 64
+
+enum Bound {
+    BOUND_NONE = 0,
+    BOUND_UPPER = 1,   // fail-low：真正的分數 <= score
+    BOUND_LOWER = 2,   // fail-high：真正的分數 >= score
+    BOUND_EXACT = 3
+};
+
+// 一筆 16 bytes：64-bit key 與壓縮成 64 bits 的資料
+//   data: score(16) | depth(8) | bound(2) | generation(6) | move(8)
+// 多個執行緒共用時不加鎖：存的是 key ^ data，讀到被同時寫壞的一筆時 key 對不上，當成沒有資料
+struct TTEntry {
+    std::atomic<uint64_t> check;   // key ^ data
+    std::atomic<uint64_t> data;
+};
+
+// 一個 bucket 剛好 64 bytes，對齊 cache line，一次 probe 只碰一條 cache line
+struct TTBucket {
+    TTEntry entries[TT_BUCKET_ENTRIES];
+};
+
+// 查詢結果（解開後的欄位）
+struct TTProbe {
+    int score;
+    int depth;
+    int bound;
+    int move;
+};
+
+// 固定大小的置換表，可由多個搜尋執行緒共用；替換策略：同一個 key 直接覆蓋，
+// 否則在 bucket 中挑「深度 - 8 x 經過的搜尋次數」最小的一筆（空位優先）
+class TranspositionTable {
+private:
+    TTBucket* buckets;
+    size_t bucket_mask;
+    std::atomic<int> generation;
+
+    static uint64_t pack(int score, int depth, int bound, int generation, int move) {
+        return ((uint64_t)(uint16_t)(int16_t)score << 24) |
+               ((uint64_t)(uint8_t)depth << 16) |
+               ((uint64_t)((bound << 6) | (generation & 0x3f)) << 8) |
+               (uint64_t)(uint8_t)move;
+    }
+
+    static int data_depth(uint64_t data) { return (int)((data >> 16) & 0xff); }
+    static int data_generation(uint64_t data) { return (int)((data >> 8) & 0x3f); }
+
+    // 讀出一筆；被其他執行緒寫到一半的資料會驗證失敗，回傳 0
+    static uint64_t load(const TTEntry& e, uint64_t& key) {
+        uint64_t data = e.data.load(std::memory_order_relaxed);
+        key = e.check.load(std::memory_order_relaxed) ^ data;
+        return data;
+    }
+
+    TTBucket* bucket_for(uint64_t key) const {
+        return &buckets[key & bucket_mask];
+    }
+
+public:
+    explicit TranspositionTable(size_t megabytes) : buckets(NULL), bucket_mask(0), generation(0) {
+        resize(megabytes);
+    }
+
+    ~TranspositionTable() {
+        free(buckets);
+    }
+
+    // 大小取不超過指定 MB 的 2 的次方個 bucket（至少一個）
+    void resize(size_t megabytes) {
+        size_t count = 1;
+        while (count * 2 * sizeof(TTBucket) <= megabytes * 1024 * 1024) {
+            count *= 2;
+        }
+
+        free(buckets);
+        void* memory = NULL;
+        if (posix_memalign(&memory, 64, count * sizeof(TTBucket)) != 0) {
+            memory = NULL;
+            count = 0;
+        }
+        buckets = (TTBucket*)memory;
+        bucket_mask = count > 0 ? count - 1 : 0;
+        clear();
+    }
+
+    void clear() {
+        generation.store(0, std::memory_order_relaxed);
+        if (buckets == NULL) return;
+        for (size_t i = 0; i <= bucket_mask; i++) {
+            for (int j = 0; j < TT_BUCKET_ENTRIES; j++) {
+                buckets[i].entries[j].check.store(0, std::memory_order_relaxed);
+                buckets[i].entries[j].data.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // 每次從根節點開始新的搜尋時呼叫，讓舊資料較容易被替換
+    void new_search() { generation.fetch_add(1, std::memory_order_relaxed); }
+
+    size_t size_bytes() const { return buckets ? (bucket_mask + 1) * sizeof(TTBucket) : 0; }
+
+    bool probe(uint64_t key, TTProbe& out) const {
+        if (buckets == NULL) return false;
+
+        const TTBucket* bucket = bucket_for(key);
+        for (int i = 0; i < TT_BUCKET_ENTRIES; i++) {
+            uint64_t entry_key;
+            uint64_t data = load(bucket->entries[i], entry_key);
+            if (entry_key == key && data != 0) {
+                out.score = (int16_t)(uint16_t)(data >> 24);
+                out.depth = data_depth(data);
+                out.bound = (int)((data >> 14) & 0x3);
+                out.move = (int)(data & 0xff);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void store(uint64_t key, int depth, int bound, int score, int move) {
+        if (buckets == NULL) return;
+
+        int current = generation.load(std::memory_order_relaxed);
+        TTBucket* bucket = bucket_for(key);
+        TTEntry* victim = &bucket->entries[0];
+        int victim_value = 1 << 30;
+
+        for (int i = 0; i < TT_BUCKET_ENTRIES; i++) {
+            TTEntry* e = &bucket->entries[i];
+            uint64_t entry_key;
+            uint64_t data = load(*e, entry_key);
+            if (entry_key == key || data == 0) {
+                victim = e;
+                break;
+            }
+            int age = (current - data_generation(data)) & 0x3f;
+            int value = data_depth(data) - 8 * age;
+            if (value < victim_value) {
+                victim_value = value;
+                victim = e;
+            }
+        }
+
+        uint64_t data = pack(score, depth, bound, current, move);
+        victim->data.store(data, std::memory_order_relaxed);
+        victim->check.store(key ^ data, std::memory_order_relaxed);
+    }
+};
+
+#endif // TRANSPOSITION_HPP